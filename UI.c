@@ -7,8 +7,11 @@
 #include "printf.h"
 #include "timer.h"
 #include "gl.c"
+#include "fb_extra.h"
+#include "gl_extra.h"
 #include "strings.h"
 #include "keyboard.h"
+#include "keyboard_extra.h"
 #include "ps2_keys.h"
 
 #define WIDTH 1280
@@ -16,23 +19,34 @@
 
 #define KNOB_RADIUS 50
 #define NUM_KNOBS 5
+#define KNOB_SPACING (WIDTH / (NUM_KNOBS + 1))
 
-#define instructions_counter 0
+#define BACKGROUND gl_color(0x30, 0x30, 0x30)
+#define STATUS_Y (HEIGHT / 2 + 200)
+
+// Redraws are capped at this rate; keys are handled every pass
+#define UI_FPS 30
+#define UI_FRAME_TICKS (24000000 / UI_FPS)
 
 // Output values
-static struct {
+typedef struct {
     int level;
     int compression_threshold;
     int compression_ratio;
     bool backing_track;
     int length_of_recording;
     bool reverb;
-} config = {
+    bool live;
+} mixer_config_t;
+
+static mixer_config_t config = {
     .level = 0,
     .compression_threshold = 20,
+    .compression_ratio = 4,
     .backing_track = false,
     .length_of_recording = 3,
-    .reverb = false
+    .reverb = false,
+    .live = false
 };
 
 // Next
@@ -110,52 +124,72 @@ void base() {
     gl_draw_rect(WIDTH / 2 - 150, HEIGHT / 2 + 100, 300, 50, GL_WHITE);
 
     // Draw press Insert text
-    const char *press_enter_text = "Press Insert to start recording";
+    const char *press_enter_text = "Press Insert to start recording, L to go live";
     int press_enter_text_x = WIDTH / 2 - (strlen(press_enter_text) * 14) / 2;
     gl_draw_string(press_enter_text_x, HEIGHT - 50, press_enter_text, GL_WHITE);
 }
 
-void draw_knobs(int selected_knob) {
-    gl_clear(gl_color(0x30, 0x30, 0x30));
-
-    // Draw the mixer interface
-    int spacing = WIDTH / (NUM_KNOBS + 1);
+// Screen area of knob i: its label, circle and selection border
+static fb_rect_t knob_cell(int i) {
+    int knob_x = (i + 1) * KNOB_SPACING;
+    int knob_y = HEIGHT / 2;
+    return (fb_rect_t){
+        .x = knob_x - KNOB_SPACING / 2,
+        .y = knob_y - KNOB_RADIUS - 24,
+        .w = KNOB_SPACING,
+        .h = 2 * KNOB_RADIUS + 29,
+    };
+}
 
+// Draw knob i over whatever is in its cell
+void draw_knob(int i, bool selected) {
     // Labels for knobs
     const char *labels[] = {"Volume", "Compression", "Backing Track", "Length", "Echo"};
 
-    for (int i = 1; i <= NUM_KNOBS; i++) {
-        int knob_x = i * spacing;
-        int knob_y = HEIGHT / 2;
+    int knob_x = (i + 1) * KNOB_SPACING;
+    int knob_y = HEIGHT / 2;
 
-        // Draw the knob circle
-        gl_draw_circle(knob_x, knob_y, KNOB_RADIUS, gl_color(0x80, 0x80, 0x80));
+    // Draw the knob circle
+    gl_draw_circle(knob_x, knob_y, KNOB_RADIUS, gl_color(0x80, 0x80, 0x80));
 
-        // Draw the knob indicator
-        gl_draw_line(knob_x, knob_y, knob_x, knob_y - KNOB_RADIUS, GL_WHITE);
+    // Draw the knob indicator
+    gl_draw_line(knob_x, knob_y, knob_x, knob_y - KNOB_RADIUS, GL_WHITE);
 
-        // Draw the label above the knob
-        gl_draw_string(knob_x - (strlen(labels[i-1]) * 14) / 2, knob_y - KNOB_RADIUS - 20, labels[i-1], GL_WHITE);
-
-        // Draw the selection rectangle border if this knob is selected
-        if (i - 1 == selected_knob) {
-            int rect_x = knob_x - KNOB_RADIUS - 10;
-            int rect_y = knob_y - KNOB_RADIUS - 24;
-            int rect_width = 2 * KNOB_RADIUS + 20;
-            int rect_height = 2 * KNOB_RADIUS + 28;
-
-            gl_draw_line(rect_x, rect_y, rect_x + rect_width, rect_y, GL_WHITE);
-            gl_draw_line(rect_x, rect_y + rect_height, rect_x + rect_width, rect_y + rect_height, GL_WHITE); 
-            gl_draw_line(rect_x, rect_y, rect_x, rect_y + rect_height, GL_WHITE); 
-            gl_draw_line(rect_x + rect_width, rect_y, rect_x + rect_width, rect_y + rect_height, GL_WHITE); 
-        }
+    // Draw the label above the knob
+    gl_draw_string(knob_x - (strlen(labels[i]) * 14) / 2, knob_y - KNOB_RADIUS - 20, labels[i], GL_WHITE);
+
+    // Draw the selection rectangle border if this knob is selected
+    if (selected) {
+        int rect_x = knob_x - KNOB_RADIUS - 10;
+        int rect_y = knob_y - KNOB_RADIUS - 24;
+        int rect_width = 2 * KNOB_RADIUS + 20;
+        int rect_height = 2 * KNOB_RADIUS + 28;
+
+        gl_draw_line(rect_x, rect_y, rect_x + rect_width, rect_y, GL_WHITE);
+        gl_draw_line(rect_x, rect_y + rect_height, rect_x + rect_width, rect_y + rect_height, GL_WHITE); 
+        gl_draw_line(rect_x, rect_y, rect_x, rect_y + rect_height, GL_WHITE); 
+        gl_draw_line(rect_x + rect_width, rect_y, rect_x + rect_width, rect_y + rect_height, GL_WHITE); 
     }
+}
 
-    // White rectangle for interface
+// White rectangle the current value is written in
+void draw_value_box(void) {
     gl_draw_rect(WIDTH / 2 - 150, HEIGHT / 2 + 100, 300, 50, GL_WHITE);
+}
+
+void draw_knobs(int selected_knob) {
+    gl_clear(BACKGROUND);
+
+    // Draw the mixer interface
+    for (int i = 0; i < NUM_KNOBS; i++) {
+        draw_knob(i, i == selected_knob);
+    }
+
+    // White rectangle for interface
+    draw_value_box();
 
     // Draw press Insert text
-    const char *press_enter_text = "Press Insert to start recording";
+    const char *press_enter_text = "Press Insert to record a take, L to go live (L again to stop)";
     int press_enter_text_x = WIDTH / 2 - (strlen(press_enter_text) * 14) / 2;
     gl_draw_string(press_enter_text_x, HEIGHT - 50, press_enter_text, GL_WHITE);
 }
@@ -194,36 +228,15 @@ void draw_value(int selected_knob) {
 }
 
 void instructions(const char* text) {
-    const int CHAR_WIDTH = 14;  // Width of a single character
     const int LINE_HEIGHT = 20; // Height between lines of text
 
-    int max_chars_per_line = WIDTH / CHAR_WIDTH;
-    int text_length = strlen(text);
-    int line = 0;
-
-    for (int start_index = 0; start_index < text_length; start_index += max_chars_per_line) {
-        int end_index = start_index + max_chars_per_line;
-
-        if (end_index > text_length) {
-            end_index = text_length;
-        }
-
-        // Calculate the length of the current line
-        int line_length = end_index - start_index;
-
-        // Calculate the position to start drawing the current line
-        int text_x = WIDTH / 2 - (line_length * CHAR_WIDTH) / 2;
-        int text_y = 10 + line * LINE_HEIGHT;
-
-        // Draw each character in the current line
-        for (int i = start_index; i < end_index; i++) {
-            gl_draw_char(text_x, text_y, text[i], GL_WHITE);
-            text_x += CHAR_WIDTH;
-        }
-
-        // Move to the next line
-        line++;
+    // Lay out each string once: lines of as many characters as fit across
+    // the screen, centered
+    static gl_text_t layout;
+    if (layout.source != text) {
+        gl_text_layout(&layout, text, 0, 10, WIDTH, LINE_HEIGHT);
     }
+    gl_draw_text(&layout, GL_WHITE);
 }
 
 void next() {
@@ -283,56 +296,163 @@ void print_config_values() {
     printf("Reverb: %d\n", config.reverb);
 }
 
-void run(void) {
-    // Initialize
-    //keyboard_init(KEYBOARD_CLOCK, KEYBOARD_DATA);
-    //gl_init(WIDTH, HEIGHT, GL_DOUBLEBUFFER);
-    //uart_init();
-
-    if (instructions_counter == 0) {
-        // Welcome
-        welcome();
-        next();
-
-        // Instructions
-        base();
-        instructions("Hello! This is the JK Mixer! This is how everything works!");
-        next();
-        base();
-        instructions("Below we have 5 knobs, that control Volume, Compression, Backing Track, Recording Length,  and Reverb!");
-        next();
-        base();
-        instructions("Use the left and right arrows to move along each control, and use the up and down arrows to change the values!");
-        next();
-        base();
-        instructions("Once you're done, press Insert to begin your recording!");
-        next();
-        base();
-        instructions("We hope you enjoy :)");
-        next();
+// Welcome and instructions, once at startup, before any audio runs
+void intro(void) {
+    // Welcome
+    welcome();
+    next();
+
+    // Instructions
+    base();
+    instructions("Hello! This is the JK Mixer! This is how everything works!");
+    next();
+    base();
+    instructions("Below we have 5 knobs, that control Volume, Compression, Backing Track, Recording Length,  and Reverb!");
+    next();
+    base();
+    instructions("Use the left and right arrows to move along each control, and use the up and down arrows to change values, even while audio plays!");
+    next();
+    base();
+    instructions("Once you're done, press Insert to begin your recording, or L to mix live!");
+    next();
+    base();
+    instructions("We hope you enjoy :)");
+    next();
+}
+
+typedef enum {
+    UI_NONE,
+    UI_RECORD,      // Insert: record a take
+    UI_LIVE,        // L: start or stop live mixing
+    // looper, on the selected track (keys 1 up to LOOPER_TRACKS select it)
+    UI_LOOP_RECORD,     // R
+    UI_LOOP_OVERDUB,    // O
+    UI_LOOP_PLAY,       // P
+    UI_LOOP_MUTE,       // M: toggle
+    UI_LOOP_UNDO,       // U
+    UI_LOOP_CLEAR,      // C
+} ui_action_t;
+
+// Parts of the mixer screen out of date, repainted on the next frame
+#define DIRTY_KNOB(i) (1u << (i))
+#define DIRTY_VALUE (1u << NUM_KNOBS)
+#define DIRTY_STATUS (1u << (NUM_KNOBS + 1))
+#define DIRTY_SCREEN (1u << (NUM_KNOBS + 2))   // everything, from a clear
+
+// Mixer screen state between passes of the main loop
+static struct {
+    int selected_knob;
+    int track;                  // looper track the loop keys act on
+    const char *status;         // what the audio engine is doing
+    unsigned int dirty;         // DIRTY_ bits
+    bool settings_changed;      // knobs moved since ui_settings_changed()
+    unsigned long last_frame;   // ticks at the last redraw
+} ui = {
+    .status = "Ready",
+    .dirty = DIRTY_SCREEN,
+};
+
+void ui_set_status(const char *status) {
+    if (status != ui.status) {
+        ui.status = status;
+        ui.dirty |= DIRTY_STATUS;
     }
+}
 
-    int selected_knob = 0;
+// True once after any knob changes
+bool ui_settings_changed(void) {
+    bool changed = ui.settings_changed;
+    ui.settings_changed = false;
+    return changed;
+}
 
-    while (1) {
-        draw_knobs(selected_knob);
-        draw_value(selected_knob);
+static void draw_status(void) {
+    char status[80];
+    snprintf(status, sizeof(status), "%s - loop track %d", ui.status, ui.track + 1);
+    gl_draw_string(WIDTH / 2 - (strlen(status) * 14) / 2, STATUS_Y, status, GL_WHITE);
+}
+
+/*
+ * Repaint the parts of the mixer screen marked in ui.dirty and show it.
+ * fb_swap_buffer() copies each frame's damage into the other buffer, so
+ * the draw buffer already holds the screen as shown and only the dirty
+ * parts are redrawn, over their own background.
+ */
+static void draw_mixer(void) {
+    if (ui.dirty & DIRTY_SCREEN) {
+        draw_knobs(ui.selected_knob);
+        draw_value(ui.selected_knob);
         instructions("Use the arrow keys to select different knobs. Use up/down to change values.");
-        gl_swap_buffer();
+        draw_status();
+    } else {
+        for (int i = 0; i < NUM_KNOBS; i++) {
+            if (ui.dirty & DIRTY_KNOB(i)) {
+                fb_rect_t cell = knob_cell(i);
+                gl_draw_rect(cell.x, cell.y, cell.w, cell.h, BACKGROUND);
+                draw_knob(i, i == ui.selected_knob);
+            }
+        }
+        if (ui.dirty & DIRTY_VALUE) {
+            draw_value_box();
+            draw_value(ui.selected_knob);
+        }
+        if (ui.dirty & DIRTY_STATUS) {
+            gl_draw_rect(0, STATUS_Y, WIDTH, gl_get_char_height(), BACKGROUND);
+            draw_status();
+        }
+    }
+    gl_swap_buffer();
+}
 
-        unsigned char key = keyboard_read_next();
-        if (key == PS2_KEY_ARROW_RIGHT) {
-            move_selection(&selected_knob, 1);
-        } else if (key == PS2_KEY_ARROW_LEFT) {
-            move_selection(&selected_knob, -1);
-        } else if (key == PS2_KEY_ARROW_UP) {
-            adjust_value(selected_knob, 1);
-        } else if (key == PS2_KEY_ARROW_DOWN) {
-            adjust_value(selected_knob, -1);
+/*
+ * One pass of the mixer screen: handle every key waiting (without
+ * blocking) and redraw if anything changed, at most UI_FPS times a
+ * second. Call it from the main loop as often as possible.
+ */
+ui_action_t ui_poll(void) {
+    ui_action_t action = UI_NONE;
+    int key;
+    while (action == UI_NONE && (key = keyboard_poll_next()) >= 0) {
+        if (key == PS2_KEY_ARROW_RIGHT || key == PS2_KEY_ARROW_LEFT) {
+            // the border moves between two knobs, and the value shown changes
+            ui.dirty |= DIRTY_KNOB(ui.selected_knob) | DIRTY_VALUE;
+            move_selection(&ui.selected_knob, key == PS2_KEY_ARROW_RIGHT ? 1 : -1);
+            ui.dirty |= DIRTY_KNOB(ui.selected_knob);
+            continue;
+        } else if (key == PS2_KEY_ARROW_UP || key == PS2_KEY_ARROW_DOWN) {
+            adjust_value(ui.selected_knob, key == PS2_KEY_ARROW_UP ? 1 : -1);
+            ui.settings_changed = true;
+            ui.dirty |= DIRTY_VALUE;
+            continue;
         } else if (key == PS2_KEY_INSERT) {
-            print_config_values();
-            return;
+            action = UI_RECORD;
+        } else if (key == 'l' || key == 'L') {
+            action = UI_LIVE;
+        } else if (key >= '1' && key < '1' + LOOPER_TRACKS) {
+            ui.track = key - '1';
+        } else if (key == 'r' || key == 'R') {
+            action = UI_LOOP_RECORD;
+        } else if (key == 'o' || key == 'O') {
+            action = UI_LOOP_OVERDUB;
+        } else if (key == 'p' || key == 'P') {
+            action = UI_LOOP_PLAY;
+        } else if (key == 'm' || key == 'M') {
+            action = UI_LOOP_MUTE;
+        } else if (key == 'u' || key == 'U') {
+            action = UI_LOOP_UNDO;
+        } else if (key == 'c' || key == 'C') {
+            action = UI_LOOP_CLEAR;
+        } else {
+            continue;
         }
+        ui.dirty |= DIRTY_STATUS;
     }
-}
 
+    unsigned long now = timer_get_ticks();
+    if (ui.dirty && now - ui.last_frame >= UI_FRAME_TICKS) {
+        draw_mixer();
+        ui.dirty = 0;
+        ui.last_frame = now;
+    }
+    return action;
+}
@@ -0,0 +1,117 @@
+/* File: adpcm.c
+ * -------------
+ *  IMA-ADPCM block decoder and streaming reader for backing tracks
+ */
+#include "adpcm.h"
+#include "strings.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static int num_blocks(const adpcm_asset_t *asset) {
+    return (asset->num_samples + asset->block_samples - 1) / asset->block_samples;
+}
+
+int adpcm_decode_block(const adpcm_asset_t *asset, int block, int16_t *out) {
+    if (block < 0 || block >= num_blocks(asset)) {
+        return 0;
+    }
+    const uint8_t *p = asset->data + block * asset->block_bytes;
+    int n = asset->num_samples - block * asset->block_samples;
+    if (n > asset->block_samples) {
+        n = asset->block_samples;
+    }
+
+    int predictor = (int16_t)(p[0] | (p[1] << 8));
+    int index = p[2];
+    if (index > 88) {
+        index = 88;
+    }
+    p += ADPCM_BLOCK_HEADER_BYTES;
+    out[0] = (int16_t)predictor;
+
+    for (int i = 1; i < n; i++) {
+        int code = (i & 1) ? (*p & 0xf) : (*p++ >> 4);
+        int step = step_table[index];
+
+        // diff = (code + 0.5) * step / 4, computed the standard shift-add way
+        int diff = step >> 3;
+        if (code & 4) diff += step;
+        if (code & 2) diff += step >> 1;
+        if (code & 1) diff += step >> 2;
+        predictor += (code & 8) ? -diff : diff;
+        if (predictor > INT16_MAX) predictor = INT16_MAX;
+        if (predictor < INT16_MIN) predictor = INT16_MIN;
+
+        index += index_table[code & 7];
+        if (index < 0) index = 0;
+        if (index > 88) index = 88;
+        out[i] = (int16_t)predictor;
+    }
+    return n;
+}
+
+bool adpcm_stream_init(adpcm_stream_t *stream, const adpcm_asset_t *asset, adpcm_end_t at_end) {
+    if (asset->block_samples > ADPCM_MAX_BLOCK_SAMPLES ||
+        asset->block_samples != ADPCM_BLOCK_SAMPLES(asset->block_bytes)) {
+        return false;
+    }
+    stream->asset = asset;
+    stream->at_end = at_end;
+    adpcm_stream_rewind(stream);
+    return true;
+}
+
+void adpcm_stream_rewind(adpcm_stream_t *stream) {
+    stream->block = 0;
+    stream->pos = 0;
+    stream->finished = false;
+    stream->avail = adpcm_decode_block(stream->asset, 0, stream->decoded);
+}
+
+int adpcm_stream_read(adpcm_stream_t *stream, int16_t *out, int n) {
+    int written = 0;
+
+    while (written < n && !stream->finished) {
+        if (stream->pos == stream->avail) {
+            // current block used up: decode the next one just in time
+            int next = stream->block + 1;
+            int avail = adpcm_decode_block(stream->asset, next, stream->decoded);
+            if (avail == 0) {
+                if (stream->at_end == ADPCM_STOP || stream->avail == 0) {
+                    stream->finished = true;
+                    break;
+                }
+                next = 0;
+                avail = adpcm_decode_block(stream->asset, 0, stream->decoded);
+            }
+            stream->block = next;
+            stream->avail = avail;
+            stream->pos = 0;
+        }
+
+        int chunk = stream->avail - stream->pos;
+        if (chunk > n - written) {
+            chunk = n - written;
+        }
+        memcpy(out + written, stream->decoded + stream->pos, chunk * sizeof(int16_t));
+        stream->pos += chunk;
+        written += chunk;
+    }
+
+    if (written < n) {
+        memset(out + written, 0, (n - written) * sizeof(int16_t));
+    }
+    return written;
+}
@@ -0,0 +1,82 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * IMA-ADPCM backing-track assets.
+ *
+ * An asset is mono audio cut into fixed-size blocks. Each block starts
+ * with a 4-byte header (first sample as int16 little-endian, step index,
+ * one reserved byte), followed by 4-bit codes, two per byte with the low
+ * nibble first. Because every block restarts the predictor, the decoder
+ * can rewind or loop to any block boundary without decoding what came
+ * before it. At 4 bits per sample the data is about a quarter the size
+ * of 16-bit PCM.
+ *
+ * Assets are produced on the host by tools/wav2adpcm, which writes a C
+ * header that defines a const adpcm_asset_t.
+ */
+
+#define ADPCM_BLOCK_HEADER_BYTES 4
+
+typedef struct {
+    int sample_rate;
+    int num_samples;        // total decoded length
+    int block_bytes;        // size of every block, header included
+    int block_samples;      // samples per full block (last block may be short)
+    const uint8_t *data;    // num_blocks * block_bytes
+} adpcm_asset_t;
+
+// Samples held in a block of `block_bytes` bytes
+#define ADPCM_BLOCK_SAMPLES(block_bytes) (((block_bytes) - ADPCM_BLOCK_HEADER_BYTES) * 2 + 1)
+
+typedef enum {
+    ADPCM_LOOP,     // wrap to the first sample at the end of the track
+    ADPCM_STOP,     // play once, then output silence
+} adpcm_end_t;
+
+// Largest block the streaming decoder will accept
+#define ADPCM_MAX_BLOCK_SAMPLES 1017
+
+/*
+ * Streaming decoder. Decodes one block at a time into `decoded`, just
+ * ahead of the read position, so only a block of PCM is ever resident.
+ */
+typedef struct {
+    const adpcm_asset_t *asset;
+    adpcm_end_t at_end;
+    int block;              // index of the block held in decoded[]
+    int avail;              // decoded samples in that block
+    int pos;                // next sample to hand out from decoded[]
+    bool finished;          // ADPCM_STOP and the last sample has been read
+    int16_t decoded[ADPCM_MAX_BLOCK_SAMPLES];
+} adpcm_stream_t;
+
+/*
+ * Decode one block into `out`, which must hold asset->block_samples.
+ *
+ * @return number of samples decoded, 0 if `block` is past the end
+ */
+int adpcm_decode_block(const adpcm_asset_t *asset, int block, int16_t *out);
+
+/*
+ * Attach `stream` to `asset`, positioned at the first sample.
+ *
+ * @return false if the asset's blocks are larger than the decoder allows
+ */
+bool adpcm_stream_init(adpcm_stream_t *stream, const adpcm_asset_t *asset, adpcm_end_t at_end);
+
+// Go back to the first sample
+void adpcm_stream_rewind(adpcm_stream_t *stream);
+
+/*
+ * Copy the next `n` samples into `out`. With ADPCM_LOOP the track wraps.
+ * With ADPCM_STOP the rest of `out` is zero-filled once the track ends.
+ *
+ * @return number of track samples written (less than n only after the end)
+ */
+int adpcm_stream_read(adpcm_stream_t *stream, int16_t *out, int n);
+
+#endif
@@ -0,0 +1,137 @@
+/* File: arena.c
+ * -------------
+ *  Named bump-pointer arenas and fixed-size object pools
+ */
+#include "arena.h"
+#include "malloc.h"
+#include "printf.h"
+#include <stdint.h>
+
+arena_t audio_arena = ARENA_INIT("audio", AUDIO_ARENA_BYTES, ARENA_CACHE_LINE);
+arena_t graphics_arena = ARENA_INIT("graphics", GRAPHICS_ARENA_BYTES, ARENA_CACHE_LINE);
+
+static arena_t *const all_arenas[] = { &audio_arena, &graphics_arena };
+#define NUM_ARENAS (sizeof(all_arenas) / sizeof(all_arenas[0]))
+
+static inline size_t align_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+// The one heap allocation an arena ever makes, padded so base meets its alignment
+static bool claim_backing(arena_t *arena) {
+    void *block = malloc(arena->size + arena->align);
+    if (!block) {
+        return false;
+    }
+    arena->base = (unsigned char *)align_up((uintptr_t)block, arena->align);
+    return true;
+}
+
+void *arena_alloc_aligned(arena_t *arena, size_t nbytes, size_t align) {
+    if (!arena->base && !claim_backing(arena)) {
+        arena->failures++;
+        return NULL;
+    }
+    if (align < arena->align) {
+        align = arena->align;
+    }
+    // base is aligned to arena->align; stricter requests align the address itself
+    size_t start = align_up((uintptr_t)(arena->base + arena->used), align) - (uintptr_t)arena->base;
+    if (start > arena->size || nbytes > arena->size - start) {
+        arena->failures++;
+        return NULL;
+    }
+    arena->used = start + nbytes;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    arena->allocs++;
+    return arena->base + start;
+}
+
+void *arena_alloc(arena_t *arena, size_t nbytes) {
+    return arena_alloc_aligned(arena, nbytes, arena->align);
+}
+
+size_t arena_mark(const arena_t *arena) {
+    return arena->used;
+}
+
+void arena_release(arena_t *arena, size_t mark) {
+    if (mark < arena->used) {
+        arena->used = mark;
+    }
+}
+
+void arena_reset(arena_t *arena) {
+    arena->used = 0;
+    arena->allocs = 0;
+}
+
+void arena_reset_all(void) {
+    for (int i = 0; i < NUM_ARENAS; i++) {
+        arena_reset(all_arenas[i]);
+    }
+}
+
+void arena_report(const arena_t *arena) {
+    printf("  arena %s: %ld of %ld KiB in use (%d allocations), high water %ld KiB",
+           arena->name, arena->used >> 10, arena->size >> 10, arena->allocs, arena->high_water >> 10);
+    if (arena->failures) {
+        printf(", %d FAILED", arena->failures);
+    }
+    printf("\n");
+}
+
+void arena_report_all(void) {
+    for (int i = 0; i < NUM_ARENAS; i++) {
+        arena_report(all_arenas[i]);
+    }
+}
+
+// Pools: free objects are linked through their first word
+
+bool pool_init(pool_t *pool, const char *name, arena_t *arena, size_t object_size, unsigned int capacity) {
+    pool->name = name;
+    pool->object_size = align_up(object_size < sizeof(void *) ? sizeof(void *) : object_size, sizeof(void *));
+    pool->capacity = capacity;
+    pool->free_list = NULL;
+    pool->used = pool->high_water = 0;
+
+    unsigned char *objects = arena_alloc(arena, pool->object_size * capacity);
+    if (!objects) {
+        pool->capacity = 0;
+        return false;
+    }
+    for (int i = capacity - 1; i >= 0; i--) {
+        void **obj = (void **)(objects + i * pool->object_size);
+        *obj = pool->free_list;
+        pool->free_list = obj;
+    }
+    return true;
+}
+
+void *pool_alloc(pool_t *pool) {
+    void **obj = pool->free_list;
+    if (!obj) {
+        return NULL;
+    }
+    pool->free_list = *obj;
+    if (++pool->used > pool->high_water) {
+        pool->high_water = pool->used;
+    }
+    return obj;
+}
+
+void pool_free(pool_t *pool, void *obj) {
+    if (obj) {
+        *(void **)obj = pool->free_list;
+        pool->free_list = obj;
+        pool->used--;
+    }
+}
+
+void pool_report(const pool_t *pool) {
+    printf("  pool %s: %d of %d objects (%ld bytes each) in use, high water %d\n",
+           pool->name, pool->used, pool->capacity, pool->object_size, pool->high_water);
+}
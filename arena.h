@@ -0,0 +1,93 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Region allocator for the long-lived buffers: sample storage, reverb
+ * lines, framebuffers, console text. Each arena takes one block from the
+ * heap the first time it is used and hands out pieces of it by bumping
+ * an offset, so an allocation is O(1) and nothing is ever freed on its
+ * own: the whole arena is reset at once (or rewound to a mark). Because
+ * the heap only ever sees the one block per arena, takes and screen
+ * re-inits cannot fragment it.
+ *
+ * On top of an arena, a pool hands out fixed-size objects from a free
+ * list (O(1) alloc and free) for small things that come and go.
+ */
+
+// Cache line of the C906; also satisfies every DMA and DE alignment rule
+#define ARENA_CACHE_LINE 64
+
+#ifndef AUDIO_ARENA_BYTES
+#define AUDIO_ARENA_BYTES (16 << 20)
+#endif
+#ifndef GRAPHICS_ARENA_BYTES
+#define GRAPHICS_ARENA_BYTES (24 << 20)
+#endif
+
+typedef struct {
+    const char *name;
+    size_t align;           // every allocation is aligned at least this much (power of two)
+    size_t size;            // bytes of backing storage
+    unsigned char *base;    // backing storage, taken from the heap on first use
+    size_t used;
+    size_t high_water;
+    unsigned int allocs;    // since the last reset
+    unsigned int failures;  // requests that did not fit, ever
+} arena_t;
+
+#define ARENA_INIT(arena_name, bytes, alignment) \
+    { .name = (arena_name), .align = (alignment), .size = (bytes) }
+
+// Sample buffers, DMA targets and effect state, cache-line aligned
+extern arena_t audio_arena;
+// Framebuffers and console rows; fb_init resets it
+extern arena_t graphics_arena;
+
+/*
+ * @return `nbytes` (uninitialized) aligned to the arena's alignment, or
+ *         NULL if the arena is full
+ */
+void *arena_alloc(arena_t *arena, size_t nbytes);
+
+// Same, with a stricter alignment (power of two) for this allocation
+void *arena_alloc_aligned(arena_t *arena, size_t nbytes, size_t align);
+
+// Give back everything allocated after `mark` (from arena_mark), for scratch buffers
+size_t arena_mark(const arena_t *arena);
+void arena_release(arena_t *arena, size_t mark);
+
+// Forget every allocation; the high-water mark is kept
+void arena_reset(arena_t *arena);
+void arena_reset_all(void);
+
+// Print use, high-water mark and failed requests
+void arena_report(const arena_t *arena);
+void arena_report_all(void);
+
+typedef struct {
+    const char *name;
+    size_t object_size;
+    unsigned int capacity;
+    void *free_list;
+    unsigned int used;
+    unsigned int high_water;
+} pool_t;
+
+/*
+ * Carve `capacity` objects of `object_size` bytes out of `arena`. The pool
+ * lives as long as that memory does (until the arena is reset).
+ *
+ * @return false if the arena does not have room
+ */
+bool pool_init(pool_t *pool, const char *name, arena_t *arena, size_t object_size, unsigned int capacity);
+
+// @return an (uninitialized) object, or NULL if all are in use
+void *pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *obj);
+
+void pool_report(const pool_t *pool);
+
+#endif
@@ -3,9 +3,7 @@
 #include "gpio.h"
 #include "i2s.h"
 #include "audio.h"
-#include "printf.h"
 #include "mango.h"
-#include "malloc.h"
 // #include "interrupts.h"
 #include "dma.h"
 
@@ -23,12 +21,20 @@ void audio_init(int sample_freq, int block_alignment, CHANNEL_TYPE channel_type)
     // interrupts_global_enable();
 }
 
-void mic_init() 
+void mic_init(int sample_freq) 
 {
-    i2s_mic_setup(44100);
+    i2s_mic_setup(sample_freq);
     i2s_mic_enable();
 }
 
+void audio_duplex_init(int sample_freq) 
+{
+    i2s_mic_setup(sample_freq);
+    i2s_duplex_enable();
+    i2s_enable_interrupts();
+    i2s_enable_mic_interrupts();
+}
+
 /* 
    These functions transmit a wave to the RPi audio jack 
    as a pulse-width-modulated signal.
@@ -53,26 +59,67 @@ void mic_init()
    If repeat is true, the functions will not return.
 */
 
+// Polled playback: work to run while the TX FIFO is full
+static struct {
+    audio_idle_fn_t idle;
+    void *idle_aux;
+} module;
+
+void audio_set_idle(audio_idle_fn_t fn, void *aux) {
+    module.idle = fn;
+    module.idle_aux = aux;
+}
+
+// The FIFO had no room: hand the time to the idle hook, if any
+static void fifo_full(void) {
+    if (module.idle) {
+        module.idle(module.idle_aux);
+    }
+}
+
+unsigned audio_write_some(const uint16_t frames[], unsigned num_frames, int mono) {
+    // one status read per burst instead of one per sample
+    unsigned n = mono ? i2s_tx_space() : i2s_tx_space() / 2;
+    if (n > num_frames) {
+        n = num_frames;
+    }
+    if (mono) {
+        for (unsigned i = 0; i < n; i++) {
+            i2s_write_mono(frames[i]);
+        }
+    } else {
+        for (unsigned i = 0; i < n; i++) {
+            i2s_write_stereo(frames[2 * i], frames[2 * i + 1]);
+        }
+    }
+    return n;
+}
+
+// Non-blocking stereo write from two mono sources
+static unsigned write_some_mix(const uint16_t left[], const uint16_t right[], unsigned num_frames) {
+    unsigned n = i2s_tx_space() / 2;
+    if (n > num_frames) {
+        n = num_frames;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        i2s_write_stereo(left[i], right[i]);
+    }
+    return n;
+}
+
 void audio_write_i16(const uint16_t waveform[], unsigned num_samples, int mono, int repeat) 
 {
+    // stereo waveforms are interleaved L/R, two samples per frame
+    unsigned num_frames = mono ? num_samples : num_samples / 2;
     i2s_start();
     while (1) {
-        for (unsigned int sample = 0; sample < num_samples; sample++) {
-            unsigned status = i2s_get_status();
-            while (status == 0) {
-                status = i2s_get_status();
-            }
-            if (mono) {
-                uint16_t pcm = waveform[sample];
-                i2s_write_mono(pcm);
-            } else { // stereo
-                uint16_t pcm_left = waveform[sample];
-                uint16_t pcm_right = waveform[sample + 1];
-                i2s_write_stereo(pcm_left, pcm_right);
-                sample++;
+        for (unsigned done = 0; done < num_frames; ) {
+            unsigned n = audio_write_some(waveform + (mono ? done : 2 * done), num_frames - done, mono);
+            if (n == 0) {
+                fifo_full();
             }
+            done += n;
         }
-        printf("repeating\n");
         if (!repeat) break;
     }
 }
@@ -81,49 +128,81 @@ void audio_write_i16_stereo_mix(const uint16_t waveform1[], const uint16_t wavef
 {
     i2s_start();
     while (1) {
-        for (unsigned int sample = 0; sample < num_samples; sample++) {
-            unsigned status = i2s_get_status();
-            while (status == 0) {
-                status = i2s_get_status();
+        for (unsigned done = 0; done < num_samples; ) {
+            unsigned n = write_some_mix(waveform1 + done, waveform2 + done, num_samples - done);
+            if (n == 0) {
+                fifo_full();
             }
-            uint16_t pcmL = waveform1[sample];
-            uint16_t pcmR = waveform2[sample];
-            i2s_write_stereo( pcmL, pcmR );
+            done += n;
         }
-        printf("repeating\n");
         if (!repeat) break;
     }
 }
 
-void audio_write_i16_dma(uint16_t waveform[], unsigned int num_samples, int repeat) {
-
-    i2s_enable_interrupts();
-    // create a 32-bit waveform
-    uint32_t *wide_waveform = malloc(sizeof(uint32_t) * num_samples);
-    // left shift all 16-bit values into upper part of the 32-bit space
-    for (int i = 0; i < num_samples; i++) {
-        wide_waveform[i] = ((uint32_t)waveform[i] << 16);
+bool audio_write_i16_dma(const uint16_t waveform[], unsigned int num_samples) {
+    // 16-bit items straight from the waveform: no widened copy, half the bus traffic
+    volatile I2S *i2s2 = (I2S *)I2S_2_BASE;
+    if (!dma_init_width(waveform, &i2s2->regs.txfifo, num_samples * sizeof(uint16_t), DMA_WIDTH_16)) {
+        return false;
     }
+    i2s_enable_interrupts();
+    i2s_tx_16bit(true);
+    i2s_start();
+    dma_start();
+    return true;
+}
+
+bool audio_write_words_dma(const uint32_t words[], unsigned int num_samples) {
     volatile I2S *i2s2 = (I2S *)I2S_2_BASE;
-    printf("num_samples: %d\n", num_samples);
-    dma_init(wide_waveform, &i2s2->regs.txfifo, num_samples * sizeof(uint32_t)); 
+    if (!dma_init(words, &i2s2->regs.txfifo, num_samples * sizeof(uint32_t))) {
+        return false;
+    }
+    i2s_enable_interrupts();
+    i2s_tx_16bit(false);
     i2s_start();
     dma_start();
-    // i2s2->regs.i2s_int.full = 0xf0; // enable dma
-    // i2s2->regs.i2s_int.interrupt.TXEI_EN = 0x1; // enable dma
-    /*
-    printf("waiting for transfer...\n");
-    volatile struct DMA *dmac = (struct DMA *)0x03002000UL;
-    printf("dmac_cfg_regn: %p, %x\n", &dmac->dmac_channel[0].dmac_cfg_regn, *(uint32_t *)(&dmac->dmac_channel[0].dmac_cfg_regn));
-    printf("dmac_cur_src_regn: %p, %x\n", &dmac->dmac_channel[0].DMAC_CUR_SRC_REGN, *(uint32_t *)(&dmac->dmac_channel[0].DMAC_CUR_SRC_REGN));
-    printf("dmac_cur_dest_regn: %p, %x\n", &dmac->dmac_channel[0].DMAC_CUR_DEST_REGN, *(uint32_t *)(&dmac->dmac_channel[0].DMAC_CUR_DEST_REGN));
-    */
+    return true;
 }
 
-void mic_capture_dma(uint32_t *audio_samples, unsigned int num_samples) {
+bool mic_capture_dma(uint32_t *audio_samples, unsigned int num_samples) {
     volatile I2S *i2s2 = (I2S *)I2S_2_BASE;
-    dma_mic_init(&i2s2->regs.rxfifo, audio_samples, num_samples * sizeof(uint32_t));
+    if (!dma_mic_init(&i2s2->regs.rxfifo, audio_samples, num_samples * sizeof(uint32_t))) {
+        return false;
+    }
     i2s_mic_start();
     i2s_enable_mic_interrupts();
     dma_mic_start();
+    return true;
+}
+
+bool audio_play_dma(const audio_buffer_t *buf) {
+    if (!buf->interleaved) {
+        return false;
+    }
+    unsigned int n = buf->frames * buf->channels;
+    if (buf->format == AUDIO_FORMAT_S16) {
+        return audio_write_i16_dma(buf->data, n);
+    } else if (buf->format == AUDIO_FORMAT_WORD32) {
+        return audio_write_words_dma(buf->data, n);
+    }
+    return false;
+}
+
+bool audio_capture_dma(audio_buffer_t *buf) {
+    if (buf->format != AUDIO_FORMAT_WORD32 || buf->channels != 1) {
+        return false;
+    }
+    if (!mic_capture_dma(buf->data, buf->capacity)) {
+        return false;
+    }
+    buf->frames = buf->capacity;
+    return true;
+}
+
+bool audio_write(const audio_buffer_t *buf, int repeat) {
+    if (buf->format != AUDIO_FORMAT_S16 || !buf->interleaved || buf->channels > 2) {
+        return false;
+    }
+    audio_write_i16(buf->data, buf->frames * buf->channels, buf->channels == 1, repeat);
+    return true;
 }
@@ -3,17 +3,57 @@
 
 #include <stdint.h>
 #include "i2s.h"
+#include "audio_buffer.h"
 
 void audio_init(int sample_freq, int block_alignment, CHANNEL_TYPE ct);
 
-void mic_init();
+void mic_init(int sample_freq);
+
+// capture and playback at the same time (see stream.h)
+void audio_duplex_init(int sample_freq);
+
+/*
+ * Polled (non-DMA) playback. Each burst reads the TX FIFO's free space
+ * once and writes that many words back to back.
+ *
+ * audio_write_some never waits: it queues as many whole frames of
+ * `frames` (mono, or interleaved L/R when mono is 0) as fit right now
+ * and returns how many it took. Call i2s_start() first.
+ */
+unsigned audio_write_some(const uint16_t frames[], unsigned num_frames, int mono);
+
+// Called by the blocking writers below whenever the FIFO is full, so
+// other work (UI, keyboard) can run between bursts; NULL to spin
+typedef void (*audio_idle_fn_t)(void *aux);
+void audio_set_idle(audio_idle_fn_t fn, void *aux);
 
 // these functions do not return if repeat is true
 void audio_write_i16(const uint16_t waveform[], unsigned num_samples, int mono, int repeat);
 void audio_write_i16_stereo_mix(const uint16_t waveform1[], const uint16_t waveform2[], unsigned num_samples, int repeat);
 
-void audio_write_i16_dma(uint16_t waveform[], unsigned int num_samples, int repeat);
+// play 16-bit samples (mono, or interleaved L/R frames after
+// audio_init(..., STEREO)) by 16-bit DMA straight from `waveform`; the
+// buffer must stay alive until dma_complete(dma_dac_channel())
+bool audio_write_i16_dma(const uint16_t waveform[], unsigned int num_samples);
+
+// play 32-bit left-justified FIFO words straight from `words` (no copy);
+// the buffer must stay alive until dma_complete(dma_dac_channel())
+bool audio_write_words_dma(const uint32_t words[], unsigned int num_samples);
+
+bool mic_capture_dma(uint32_t *audio_samples, unsigned int num_samples);
+
+// (the three DMA writers above return false, having started nothing, if
+// no DMA channel or descriptor is free)
 
-void mic_capture_dma(uint32_t *audio_samples, unsigned int num_samples);
+/*
+ * Buffer entry points: each plays or fills `buf` in the format it is
+ * already in (S16 by 16-bit DMA, WORD32 by 32-bit DMA), with no copy.
+ *
+ * @return false for a format or layout the path cannot take as-is, or
+ * if no DMA channel or descriptor is free
+ */
+bool audio_play_dma(const audio_buffer_t *buf);      // interleaved S16 or WORD32
+bool audio_capture_dma(audio_buffer_t *buf);         // mono WORD32, fills capacity frames
+bool audio_write(const audio_buffer_t *buf, int repeat);  // polled, interleaved S16
 
 #endif
@@ -0,0 +1,211 @@
+/* File: audio_buffer.c
+ * --------------------
+ *  Typed audio buffers and the format conversion kernels between them
+ */
+#include "audio_buffer.h"
+#include "arena.h"
+#include "printf.h"
+#include "strings.h"
+#include "timer.h"
+
+unsigned int audio_format_bytes(audio_format_t format) {
+    return format == AUDIO_FORMAT_S16 ? sizeof(int16_t) : sizeof(uint32_t);
+}
+
+void audio_buffer_wrap(audio_buffer_t *buf, void *data, audio_format_t format, int channels, bool interleaved,
+                       int rate, unsigned int capacity) {
+    buf->data = data;
+    buf->format = format;
+    buf->channels = channels;
+    buf->interleaved = interleaved || channels == 1;
+    buf->rate = rate;
+    buf->frames = capacity;
+    buf->capacity = capacity;
+}
+
+void *audio_buffer_channel(const audio_buffer_t *buf, int ch) {
+    if (buf->interleaved) {
+        return buf->data;
+    }
+    return (uint8_t *)buf->data + ch * buf->capacity * audio_format_bytes(buf->format);
+}
+
+void audio_convert_word32_to_s16(const uint32_t *in, int16_t *out, unsigned int n) {
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t a = in[i], b = in[i + 1], c = in[i + 2], d = in[i + 3];
+        out[i] = (int16_t)(a >> 16);
+        out[i + 1] = (int16_t)(b >> 16);
+        out[i + 2] = (int16_t)(c >> 16);
+        out[i + 3] = (int16_t)(d >> 16);
+    }
+    for (; i < n; i++) {
+        out[i] = (int16_t)(in[i] >> 16);
+    }
+}
+
+void audio_convert_s16_to_word32(const int16_t *in, uint32_t *out, unsigned int n) {
+    // back to front, so the wider output can overwrite its own input
+    unsigned int i = n;
+    for (; i >= 4; i -= 4) {
+        int16_t a = in[i - 1], b = in[i - 2], c = in[i - 3], d = in[i - 4];
+        out[i - 1] = (uint32_t)(uint16_t)a << 16;
+        out[i - 2] = (uint32_t)(uint16_t)b << 16;
+        out[i - 3] = (uint32_t)(uint16_t)c << 16;
+        out[i - 4] = (uint32_t)(uint16_t)d << 16;
+    }
+    for (; i > 0; i--) {
+        out[i - 1] = (uint32_t)(uint16_t)in[i - 1] << 16;
+    }
+}
+
+void audio_convert_s16_to_q24(const int16_t *in, int32_t *out, unsigned int n) {
+    unsigned int i = n;
+    for (; i >= 4; i -= 4) {
+        int16_t a = in[i - 1], b = in[i - 2], c = in[i - 3], d = in[i - 4];
+        out[i - 1] = (int32_t)a << 9;
+        out[i - 2] = (int32_t)b << 9;
+        out[i - 3] = (int32_t)c << 9;
+        out[i - 4] = (int32_t)d << 9;
+    }
+    for (; i > 0; i--) {
+        out[i - 1] = (int32_t)in[i - 1] << 9;
+    }
+}
+
+void audio_convert_word32_to_q24(const uint32_t *in, int32_t *out, unsigned int n) {
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        out[i] = (int32_t)in[i] >> 7;
+        out[i + 1] = (int32_t)in[i + 1] >> 7;
+        out[i + 2] = (int32_t)in[i + 2] >> 7;
+        out[i + 3] = (int32_t)in[i + 3] >> 7;
+    }
+    for (; i < n; i++) {
+        out[i] = (int32_t)in[i] >> 7;
+    }
+}
+
+void audio_interleave_s16(const int16_t *left, const int16_t *right, int16_t *out, unsigned int frames) {
+    unsigned int i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        int16_t l0 = left[i], l1 = left[i + 1], r0 = right[i], r1 = right[i + 1];
+        out[2 * i] = l0;
+        out[2 * i + 1] = r0;
+        out[2 * i + 2] = l1;
+        out[2 * i + 3] = r1;
+    }
+    for (; i < frames; i++) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+void audio_deinterleave_s16(const int16_t *in, int16_t *left, int16_t *right, unsigned int frames) {
+    unsigned int i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        int16_t l0 = in[2 * i], r0 = in[2 * i + 1], l1 = in[2 * i + 2], r1 = in[2 * i + 3];
+        left[i] = l0;
+        right[i] = r0;
+        left[i + 1] = l1;
+        right[i + 1] = r1;
+    }
+    for (; i < frames; i++) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+// One channel's worth (or an interleaved run) of sample conversion
+static bool convert_samples(const void *in, audio_format_t from, void *out, audio_format_t to, unsigned int n) {
+    if (from == to) {
+        if (in != out) {
+            memcpy(out, in, n * audio_format_bytes(from));
+        }
+        return true;
+    }
+    if (from == AUDIO_FORMAT_WORD32 && to == AUDIO_FORMAT_S16) {
+        audio_convert_word32_to_s16(in, out, n);
+    } else if (from == AUDIO_FORMAT_S16 && to == AUDIO_FORMAT_WORD32) {
+        audio_convert_s16_to_word32(in, out, n);
+    } else if (from == AUDIO_FORMAT_S16 && to == AUDIO_FORMAT_Q24) {
+        audio_convert_s16_to_q24(in, out, n);
+    } else if (from == AUDIO_FORMAT_WORD32 && to == AUDIO_FORMAT_Q24) {
+        audio_convert_word32_to_q24(in, out, n);
+    } else {
+        // back down from Q8.24 goes through the effect chain's requantizer
+        return false;
+    }
+    return true;
+}
+
+bool audio_buffer_convert(const audio_buffer_t *src, audio_buffer_t *dst) {
+    if (dst->capacity < src->frames || dst->channels != src->channels) {
+        return false;
+    }
+    int nch = src->channels;
+    bool ok;
+    if (src->interleaved == dst->interleaved) {
+        if (src->interleaved) {
+            ok = convert_samples(src->data, src->format, dst->data, dst->format, src->frames * nch);
+        } else {
+            ok = true;
+            for (int ch = 0; ch < nch && ok; ch++) {
+                ok = convert_samples(audio_buffer_channel(src, ch), src->format, audio_buffer_channel(dst, ch),
+                                     dst->format, src->frames);
+            }
+        }
+    } else if (nch == 2 && src->format == AUDIO_FORMAT_S16 && dst->format == AUDIO_FORMAT_S16 &&
+               src->data != dst->data) {
+        if (src->interleaved) {
+            audio_deinterleave_s16(src->data, audio_buffer_channel(dst, 0), audio_buffer_channel(dst, 1), src->frames);
+        } else {
+            audio_interleave_s16(audio_buffer_channel(src, 0), audio_buffer_channel(src, 1), dst->data, src->frames);
+        }
+        ok = true;
+    } else {
+        ok = false;
+    }
+    if (ok) {
+        dst->frames = src->frames;
+        dst->rate = src->rate;
+    }
+    return ok;
+}
+
+void audio_convert_report(unsigned int n) {
+    // scratch from the audio arena, given back at the end
+    size_t mark = arena_mark(&audio_arena);
+    uint32_t *words = arena_alloc(&audio_arena, n * sizeof(uint32_t));
+    int32_t *q24 = arena_alloc(&audio_arena, n * sizeof(int32_t));
+    int16_t *s16 = arena_alloc(&audio_arena, 2 * n * sizeof(int16_t));
+    if (!words || !q24 || !s16) {
+        arena_release(&audio_arena, mark);
+        return;
+    }
+    memset(words, 0, n * sizeof(uint32_t));
+    memset(s16, 0, 2 * n * sizeof(int16_t));
+
+    // x100 so sub-tick costs still show
+    printf("Conversion kernels over %d samples:\n", (int)n);
+    unsigned long t = timer_get_ticks();
+    audio_convert_word32_to_s16(words, s16, n);
+    printf("  word32 -> s16:   %ld ticks/100 samples\n", (timer_get_ticks() - t) * 100 / n);
+    t = timer_get_ticks();
+    audio_convert_s16_to_word32(s16, words, n);
+    printf("  s16 -> word32:   %ld ticks/100 samples\n", (timer_get_ticks() - t) * 100 / n);
+    t = timer_get_ticks();
+    audio_convert_s16_to_q24(s16, q24, n);
+    printf("  s16 -> q24:      %ld ticks/100 samples\n", (timer_get_ticks() - t) * 100 / n);
+    t = timer_get_ticks();
+    audio_convert_word32_to_q24(words, q24, n);
+    printf("  word32 -> q24:   %ld ticks/100 samples\n", (timer_get_ticks() - t) * 100 / n);
+    t = timer_get_ticks();
+    audio_interleave_s16(s16, s16 + n / 2, (int16_t *)q24, n / 2);
+    printf("  interleave:      %ld ticks/100 frames\n", (timer_get_ticks() - t) * 200 / n);
+    t = timer_get_ticks();
+    audio_deinterleave_s16((int16_t *)q24, s16, s16 + n / 2, n / 2);
+    printf("  deinterleave:    %ld ticks/100 frames\n", (timer_get_ticks() - t) * 200 / n);
+
+    arena_release(&audio_arena, mark);
+}
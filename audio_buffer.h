@@ -0,0 +1,64 @@
+#ifndef AUDIO_BUFFER_H
+#define AUDIO_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A block of audio together with what it is: sample format, channel
+ * count and layout, sample rate, and how much of the storage is in use.
+ * Drivers (audio.h) and the effect chain (effects.h) take these, and
+ * convert only when the format they need differs from the one they get.
+ */
+
+typedef enum {
+    AUDIO_FORMAT_S16,       // int16_t
+    AUDIO_FORMAT_WORD32,    // 32-bit left-justified I2S FIFO words (uint32_t)
+    AUDIO_FORMAT_Q24,       // effect chain samples, Q8.24 (sample_t)
+} audio_format_t;
+
+typedef struct {
+    void *data;
+    audio_format_t format;
+    int channels;
+    bool interleaved;       // L R L R ...; otherwise one block of `capacity` samples per channel
+    int rate;               // frames per second
+    unsigned int frames;    // frames of valid audio
+    unsigned int capacity;  // frames the storage holds
+} audio_buffer_t;
+
+// Bytes per sample of one channel
+unsigned int audio_format_bytes(audio_format_t format);
+
+/*
+ * Describe existing storage of `capacity` frames. The buffer starts out
+ * full (frames = capacity), as a recording or asset usually is.
+ */
+void audio_buffer_wrap(audio_buffer_t *buf, void *data, audio_format_t format, int channels, bool interleaved,
+                       int rate, unsigned int capacity);
+
+// Start of channel `ch` (planar) or of the first frame (interleaved)
+void *audio_buffer_channel(const audio_buffer_t *buf, int ch);
+
+/*
+ * Convert `src` into `dst`'s format and layout, frames and rate included.
+ * An interleaved `dst` may wrap the same storage as `src` (the kernels
+ * run in the direction that makes in-place conversion safe); channel
+ * (de)interleaving needs separate storage.
+ *
+ * @return false if dst is too small or the conversion is not supported
+ */
+bool audio_buffer_convert(const audio_buffer_t *src, audio_buffer_t *dst);
+
+// Conversion kernels (unrolled four samples at a time)
+void audio_convert_word32_to_s16(const uint32_t *in, int16_t *out, unsigned int n);
+void audio_convert_s16_to_word32(const int16_t *in, uint32_t *out, unsigned int n);
+void audio_convert_s16_to_q24(const int16_t *in, int32_t *out, unsigned int n);
+void audio_convert_word32_to_q24(const uint32_t *in, int32_t *out, unsigned int n);
+void audio_interleave_s16(const int16_t *left, const int16_t *right, int16_t *out, unsigned int frames);
+void audio_deinterleave_s16(const int16_t *in, int16_t *left, int16_t *right, unsigned int frames);
+
+// Time every kernel over a block of `n` samples and print ticks/sample
+void audio_convert_report(unsigned int n);
+
+#endif
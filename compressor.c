@@ -0,0 +1,178 @@
+/* File: compressor.c
+ * ------------------
+ *  Fixed-point feed-forward compressor (envelope follower + dB gain computer)
+ */
+#include "compressor.h"
+#include "arena.h"
+#include "strings.h"
+
+// 20 * log10(2) in Q8: converts log2 to dB
+#define DB_PER_OCTAVE_Q8 1541
+// 256 / DB_PER_OCTAVE_Q8 in Q16: converts dB to log2
+#define OCTAVE_PER_DB_Q16 10888
+// quietest level the gain computer sees
+#define DB_FLOOR_Q8 (-120 * 256)
+// envelope coefficients are Q24
+#define COEF_ONE (1 << 24)
+
+// log2(1 + i/64) in Q8
+static const uint8_t log2_lut[64] = {
+    0, 6, 11, 17, 22, 28, 33, 38, 44, 49, 54, 59, 63, 68, 73, 78,
+    82, 87, 92, 96, 100, 105, 109, 113, 118, 122, 126, 130, 134, 138, 142, 146,
+    150, 154, 157, 161, 165, 169, 172, 176, 179, 183, 186, 190, 193, 197, 200, 203,
+    207, 210, 213, 216, 220, 223, 226, 229, 232, 235, 238, 241, 244, 247, 250, 253,
+};
+
+// 2^(i/64) in Q16
+static const uint32_t exp2_lut[64] = {
+    65536, 66250, 66971, 67700, 68438, 69183, 69936, 70698,
+    71468, 72246, 73032, 73828, 74632, 75444, 76266, 77096,
+    77936, 78785, 79642, 80510, 81386, 82273, 83169, 84074,
+    84990, 85915, 86851, 87796, 88752, 89719, 90696, 91684,
+    92682, 93691, 94711, 95743, 96785, 97839, 98905, 99982,
+    101070, 102171, 103283, 104408, 105545, 106694, 107856, 109031,
+    110218, 111418, 112631, 113858, 115098, 116351, 117618, 118899,
+    120194, 121502, 122825, 124163, 125515, 126882, 128263, 129660,
+};
+
+// Index of the highest set bit (v != 0), without relying on libgcc's clz
+static int msb(uint32_t v) {
+    int n = 0;
+    if (v >= 1u << 16) { v >>= 16; n += 16; }
+    if (v >= 1u << 8)  { v >>= 8;  n += 8; }
+    if (v >= 1u << 4)  { v >>= 4;  n += 4; }
+    if (v >= 1u << 2)  { v >>= 2;  n += 2; }
+    if (v >= 1u << 1)  { n += 1; }
+    return n;
+}
+
+int compressor_lin_to_db_q8(uint32_t magnitude, int full_scale_log2) {
+    if (magnitude == 0) {
+        return DB_FLOOR_Q8;
+    }
+    int top = msb(magnitude);
+    uint32_t mantissa = top >= 6 ? magnitude >> (top - 6) : magnitude << (6 - top);
+    int log2_q8 = (top - full_scale_log2) * 256 + log2_lut[mantissa & 63];
+    int db = (log2_q8 * DB_PER_OCTAVE_Q8) >> 8;
+    return db < DB_FLOOR_Q8 ? DB_FLOOR_Q8 : db;
+}
+
+uint32_t compressor_db_to_gain_q16(int db_q8) {
+    int log2_q8 = (int)(((int64_t)db_q8 * OCTAVE_PER_DB_Q16) >> 16);
+    int octaves = log2_q8 >> 8;   // floor
+    uint32_t gain = exp2_lut[(log2_q8 & 255) >> 2];
+    if (octaves >= 0) {
+        return octaves > 12 ? gain << 12 : gain << octaves;
+    }
+    return octaves < -17 ? 0 : gain >> -octaves;
+}
+
+struct compressor_state {
+    compressor_params_t cached;  // params the coefficients below were built from
+    int valid;
+
+    // coefficients
+    uint32_t attack_coef;   // Q24 share of the distance to the target per sample
+    uint32_t release_coef;
+    int threshold_q8;
+    int knee_q8;
+    uint32_t slope_q16;     // 1 - 1/ratio
+    int makeup_q8;
+
+    // envelope: Q30 magnitude for peak, Q30 power for RMS
+    uint32_t env;
+};
+
+static uint32_t time_coef(int ms) {
+    int nsamples = ms * EFFECT_SAMPLE_RATE / 1000;
+    return nsamples <= 1 ? COEF_ONE : COEF_ONE / nsamples;
+}
+
+static int params_equal(const compressor_params_t *a, const compressor_params_t *b) {
+    return a->threshold_db == b->threshold_db && a->ratio == b->ratio &&
+           a->knee_db == b->knee_db && a->attack_ms == b->attack_ms &&
+           a->release_ms == b->release_ms && a->makeup_db == b->makeup_db &&
+           a->detector == b->detector;
+}
+
+static void compressor_prepare(effect_t *fx) {
+    compressor_params_t *params = fx->params;
+    struct compressor_state *st = fx->state;
+
+    // params rarely change, so only rebuild coefficients when they do
+    if (st->valid && params_equal(params, &st->cached)) {
+        return;
+    }
+    st->cached = *params;
+    st->valid = 1;
+
+    st->attack_coef = time_coef(params->attack_ms);
+    st->release_coef = time_coef(params->release_ms);
+    st->threshold_q8 = params->threshold_db * 256;
+    st->knee_q8 = params->knee_db * 256;
+    st->slope_q16 = params->ratio > 1 ? 65536 - 65536 / params->ratio : 0;
+    st->makeup_q8 = params->makeup_db * 256;
+}
+
+// Gain reduction in Q8 dB for a detected level
+static int gain_reduction_q8(const struct compressor_state *st, int level_q8) {
+    int over = level_q8 - st->threshold_q8;
+    int knee = st->knee_q8;
+    if (2 * over <= -knee) {
+        return 0;
+    }
+    if (2 * over < knee) {
+        // quadratic interpolation through the knee
+        int64_t d = over + knee / 2;
+        return (int)((st->slope_q16 * d * d / (2 * knee)) >> 16);
+    }
+    return (int)(((int64_t)st->slope_q16 * over) >> 16);
+}
+
+static void compressor_process(effect_t *fx, sample_t *block, int n) {
+    struct compressor_state *st = fx->state;
+    int rms = st->cached.detector == COMPRESSOR_RMS;
+    uint32_t attack = st->attack_coef;
+    uint32_t release = st->release_coef;
+    uint32_t env = st->env;
+
+    for (int i = 0; i < n; i++) {
+        int32_t s = block[i];
+        // Q15 magnitude, capped at +6 dBFS so x * x still fits 32 bits
+        uint32_t x = (uint32_t)(s < 0 ? -(int64_t)s : s) >> (SAMPLE_FRAC_BITS - 15);
+        if (x > UINT16_MAX) x = UINT16_MAX;
+        uint32_t target = rms ? x * x : x << 15;   // Q30 either way
+
+        uint32_t coef = target > env ? attack : release;
+        env = (uint32_t)((int64_t)env + ((((int64_t)target - env) * coef) >> 24));
+
+        int level_q8 = compressor_lin_to_db_q8(env, 30);
+        if (rms) {
+            level_q8 /= 2;   // power -> amplitude
+        }
+        int gain_q8 = st->makeup_q8 - gain_reduction_q8(st, level_q8);
+        block[i] = sample_sat(((int64_t)s * compressor_db_to_gain_q16(gain_q8)) >> 16);
+    }
+    st->env = env;
+}
+
+static void compressor_reset(effect_t *fx) {
+    struct compressor_state *st = fx->state;
+    st->env = 0;
+}
+
+effect_t *effect_compressor_new(compressor_params_t *params) {
+    size_t mark = arena_mark(&audio_arena);
+    struct compressor_state *st = arena_alloc(&audio_arena, sizeof(struct compressor_state));
+    effect_t *fx = st ? effect_new("compressor", params, st) : NULL;
+    if (!fx) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    memset(st, 0, sizeof(struct compressor_state));
+    fx->prepare = compressor_prepare;
+    fx->process = compressor_process;
+    fx->reset = compressor_reset;
+    fx->budget_percent = COMPRESSOR_BUDGET_PERCENT;
+    return fx;
+}
@@ -0,0 +1,43 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include "effects.h"
+
+/*
+ * Feed-forward dynamics compressor.
+ *
+ * An envelope follower (peak or RMS) with separate attack and release
+ * tracks the input level. A dB-domain gain computer with threshold,
+ * ratio and soft knee turns that level into gain reduction, and makeup
+ * gain is added on top. Everything is fixed-point. Linear <-> dB
+ * conversion uses small lookup tables because rv64im has no FPU.
+ */
+
+typedef enum {
+    COMPRESSOR_PEAK,
+    COMPRESSOR_RMS,
+} compressor_detector_t;
+
+typedef struct {
+    int threshold_db;   // dBFS, e.g. -12
+    int ratio;          // n:1, 1 disables compression
+    int knee_db;        // soft knee width, 0 = hard knee
+    int attack_ms;
+    int release_ms;
+    int makeup_db;
+    compressor_detector_t detector;
+} compressor_params_t;
+
+// Worst-case share of real time the stage may use per block
+#define COMPRESSOR_BUDGET_PERCENT 5
+
+effect_t *effect_compressor_new(compressor_params_t *params);
+
+/*
+ * Conversions used by the gain computer, exposed for other stages.
+ * dB values are Q8 (256 = 1 dB); gains are Q16 (65536 = unity).
+ */
+int compressor_lin_to_db_q8(uint32_t magnitude, int full_scale_log2);
+uint32_t compressor_db_to_gain_q16(int db_q8);
+
+#endif
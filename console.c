@@ -4,9 +4,10 @@
  */
 #include "console.h"
 #include "gl.h"
+#include "gl_extra.h"
 
-// Add malloc, strings, printf
-#include "malloc.h"
+// Add arena, strings, printf
+#include "arena.h"
 #include "strings.h"
 #include "printf.h"
 
@@ -18,6 +19,8 @@ static struct {
     int cursor_row, cursor_col;
     // Keep track of content
     char **contents;
+    // Rows changed since the last draw (none if first > last)
+    int dirty_first, dirty_last;
 } module;
 
 // declare void functions
@@ -25,6 +28,15 @@ static void clear_contents(void);
 static void draw_console(void);
 static void process_char(char ch);
 
+static void mark_dirty(int first, int last) {
+    if (first < module.dirty_first) {
+        module.dirty_first = first;
+    }
+    if (last > module.dirty_last) {
+        module.dirty_last = last;
+    }
+}
+
 void console_init(int nrows, int ncols, color_t foreground, color_t background) {
     // Please use this amount of space between console rows
     const static int LINE_SPACING = 5;
@@ -39,18 +51,30 @@ void console_init(int nrows, int ncols, color_t foreground, color_t background)
     module.ncols = ncols;
     module.cursor_row = 0;
     module.cursor_col = 0;
+    module.dirty_first = 0;
+    module.dirty_last = nrows - 1;
+
+    // Initialize the graphics library first: it resets the graphics arena
+    gl_init(ncols * gl_get_char_width(), nrows * module.line_height, GL_DOUBLEBUFFER);
 
-    // Allocate space for console contents
-    module.contents = (char **)malloc(nrows * sizeof(char *));
+    // Allocate space for console contents, all rows in one block
+    size_t mark = arena_mark(&graphics_arena);
+    module.contents = (char **)arena_alloc(&graphics_arena, nrows * sizeof(char *));
+    char *text = (char *)arena_alloc(&graphics_arena, nrows * ncols * sizeof(char));
+    if (!module.contents || !text) {
+        // Handle allocation failure: the console stays empty and ignores output
+        arena_release(&graphics_arena, mark);
+        module.contents = NULL;
+        module.nrows = module.ncols = 0;
+        module.dirty_last = -1;     // nothing to draw
+        return;
+    }
     for (int i = 0; i < nrows; i++) {
-        module.contents[i] = (char *)malloc(ncols * sizeof(char));
+        module.contents[i] = text + i * ncols;
         memset(module.contents[i], ' ', ncols);
     }
 
-    // Initialize the graphics library and clear the console
-    gl_init(ncols * gl_get_char_width(), nrows * module.line_height, GL_DOUBLEBUFFER);
-
-    // Call console_clear to clear
+    // Clear the console
     console_clear();
 }
 
@@ -64,6 +88,9 @@ void console_clear(void) {
 
 
 int console_printf(const char *format, ...) {
+    if (!module.contents) {
+        return 0;   // console_init could not allocate its rows
+    }
     // Allocate space
     char buffer[1024];
     va_list args;
@@ -85,16 +112,24 @@ static void clear_contents(void) {
     for (int i = 0; i < module.nrows; i++) {
         memset(module.contents[i], ' ', module.ncols);
     }
+    mark_dirty(0, module.nrows - 1);
 }
 
 // Draw onto console
+// Only rows that changed are redrawn, each as one run of glyphs: the
+// swap copies what changed into the other buffer, so it already holds
+// the rest
 static void draw_console(void) {
-    gl_clear(module.bg_color);
-    for (int row = 0; row < module.nrows; row++) {
-        for (int col = 0; col < module.ncols; col++) {
-            gl_draw_char(col * gl_get_char_width(), row * module.line_height, module.contents[row][col], module.fg_color);
-        }
+    if (module.dirty_first > module.dirty_last) {
+        return;
+    }
+    int width = module.ncols * gl_get_char_width();
+    for (int row = module.dirty_first; row <= module.dirty_last; row++) {
+        gl_draw_rect(0, row * module.line_height, width, module.line_height, module.bg_color);
+        gl_draw_chars(0, row * module.line_height, module.contents[row], module.ncols, module.fg_color);
     }
+    module.dirty_first = module.nrows;
+    module.dirty_last = -1;
     gl_swap_buffer();
 }
 
@@ -115,6 +150,7 @@ static void process_char(char ch) {
                 module.cursor_col = module.ncols - 1;
             }
             module.contents[module.cursor_row][module.cursor_col] = ' ';
+            mark_dirty(module.cursor_row, module.cursor_row);
             break;
         // form feed
         case '\f':
@@ -123,6 +159,7 @@ static void process_char(char ch) {
         // Move cursor
         default:
             module.contents[module.cursor_row][module.cursor_col] = ch;
+            mark_dirty(module.cursor_row, module.cursor_row);
             module.cursor_col++;
             // Horizontal wrapping
             if (module.cursor_col >= module.ncols) {
@@ -137,6 +174,7 @@ static void process_char(char ch) {
             memcpy(module.contents[i - 1], module.contents[i], module.ncols);
         }
         memset(module.contents[module.nrows - 1], ' ', module.ncols);
+        mark_dirty(0, module.nrows - 1);
         // move cursor
         module.cursor_row = module.nrows - 1;
     }
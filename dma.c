@@ -1,7 +1,11 @@
 #include "dma.h"
-#include "malloc.h"
 #include "printf.h"
 #include "ccu.h"
+#include "ringbuf.h"
+#ifndef DMA_MOCK
+#include "hstimer.h"
+#include "interrupts.h"
+#endif
 
 #define CCU_BASE 0x2001000UL
 #define DMA_BGR_REG (CCU_BASE + 0x70C)
@@ -13,88 +17,156 @@ struct DMA_BGR {
     uint32_t UNUSED2 : 15;
 };
 
+static int completion_slots[DMA_COMPLETION_QUEUE];
+
+static struct {
+    bool channel_used[DMA_NUM_CHANNELS];
+    bool desc_used[DMA_DESC_POOL_SIZE];
+    // the DMAC links descriptors by word address, keep the pool aligned
+    struct DMA_DESCRIPTOR desc_pool[DMA_DESC_POOL_SIZE] __attribute__((aligned(64)));
+
+    // one-shot DAC and mic transfers keep their channel and descriptor
+    // across recordings
+    int dac_channel, mic_channel;
+    struct DMA_DESCRIPTOR *dac_desc, *mic_desc;
+
+    dma_ring_t *rings[DMA_NUM_CHANNELS];   // ring running on each channel
+
+    // one-shot completion delivery
+    bool irq_ready;                 // the service tick is running
+    // one flag per channel (no read-modify-write shared with the tick)
+    volatile bool in_flight[DMA_NUM_CHANNELS];  // one-shot transfer running
+    volatile bool finished[DMA_NUM_CHANNELS];   // finished, not yet waited for
+    dma_complete_fn_t handlers[DMA_NUM_CHANNELS];
+    void *handler_aux[DMA_NUM_CHANNELS];
+    ringbuf_t completions;          // finished channels (int), tick -> main loop
+} module = {
+    .dac_channel = -1,
+    .mic_channel = -1,
+    .completions = RINGBUF_INIT(completion_slots, sizeof(int), DMA_COMPLETION_QUEUE),
+};
+
+int dma_channel_request(void) {
+    for (int ch = 0; ch < DMA_NUM_CHANNELS; ch++) {
+        if (!module.channel_used[ch]) {
+            module.channel_used[ch] = true;
+            return ch;
+        }
+    }
+    return -1;
+}
+
+void dma_channel_release(int channel) {
+    if (channel < 0 || channel >= DMA_NUM_CHANNELS) {
+        return;
+    }
+    dma_disable(channel);
+    module.channel_used[channel] = false;
+}
+
+struct DMA_DESCRIPTOR *dma_desc_alloc(int count) {
+    // first fit over the pool
+    for (int start = 0; start + count <= DMA_DESC_POOL_SIZE; start++) {
+        int run = 0;
+        while (run < count && !module.desc_used[start + run]) {
+            run++;
+        }
+        if (run == count) {
+            for (int i = 0; i < count; i++) {
+                module.desc_used[start + i] = true;
+            }
+            return &module.desc_pool[start];
+        }
+        start += run;
+    }
+    return NULL;
+}
+
+void dma_desc_release(struct DMA_DESCRIPTOR *desc, int count) {
+    int start = desc - module.desc_pool;
+    for (int i = 0; i < count && start + i < DMA_DESC_POOL_SIZE; i++) {
+        module.desc_used[start + i] = false;
+    }
+}
+
+// Take a channel and a descriptor for a one-shot transfer, or neither
+static bool claim_oneshot(int *channel, struct DMA_DESCRIPTOR **desc) {
+    if (*channel >= 0) {
+        return true;
+    }
+    int ch = dma_channel_request();
+    if (ch < 0) {
+        return false;
+    }
+    struct DMA_DESCRIPTOR *d = dma_desc_alloc(1);
+    if (!d) {
+        dma_channel_release(ch);
+        return false;
+    }
+    *channel = ch;
+    *desc = d;
+    return true;
+}
+
+int dma_dac_channel(void) {
+    return module.dac_channel;
+}
+
+int dma_mic_channel(void) {
+    return module.mic_channel;
+}
+
 struct DMA_DESCRIPTOR *dma_init(const void *source_addr, volatile void *dest_addr, uint32_t byte_count) {
-    // gate the correct clock
-    // volatile struct DMA_BGR *dma_bgr = (struct DMA_BGR *)DMA_BGR_REG;
-    // dma_bgr->DMA_RST = 1;
-    // dma_bgr->DMA_GATING = 1;
+    return dma_init_width(source_addr, dest_addr, byte_count, DMA_WIDTH_32);
+}
 
-    struct DMA_DESCRIPTOR *dma_descriptor = malloc(sizeof(struct DMA_DESCRIPTOR));
-    printf("sizeof(struct DMA_DESCRIPTOR): %ld\n", sizeof(struct DMA_DESCRIPTOR));
+struct DMA_DESCRIPTOR *dma_init_width(const void *source_addr, volatile void *dest_addr, uint32_t byte_count,
+                                      dma_width_t width) {
+    if (!claim_oneshot(&module.dac_channel, &module.dac_desc)) {
+        printf("dma: no channel or descriptor free for the DAC\n");
+        return NULL;
+    }
+    struct DMA_DESCRIPTOR *dma_descriptor = module.dac_desc;
     dma_descriptor->config.DMA_SRC_DRQ_TYPE = 1;
     dma_descriptor->config.DMA_SRC_BLOCK_SIZE = 0;
     dma_descriptor->config.DMA_SRC_ADDR_MODE = 0;
-    dma_descriptor->config.DMA_SRC_DATA_WIDTH = 2;
+    dma_descriptor->config.DMA_SRC_DATA_WIDTH = width;
     dma_descriptor->config.DMA_DEST_DRQ_TYPE = 5;
     dma_descriptor->config.DMA_DEST_BLOCK_SIZE = 0;
     dma_descriptor->config.DMA_DEST_ADDR_MODE = 1;
-    dma_descriptor->config.DMA_DEST_DATA_WIDTH = 2;
+    dma_descriptor->config.DMA_DEST_DATA_WIDTH = width;
     dma_descriptor->config.BMODE_SEL = 0;
-    printf("before source: %p\n", source_addr);
-    printf("before dest:   %p\n", dest_addr);
     dma_descriptor->source_addr = (uint32_t)((uint64_t)source_addr & 0xffffffff);
     dma_descriptor->dest_addr = (uint32_t)((uint64_t)dest_addr & 0xffffffff);
     dma_descriptor->byte_count = byte_count;
-    printf("byte count: %d\n", dma_descriptor->byte_count);
     dma_descriptor->parameter.WAIT_CLOCK_CYCLES = 0;
     dma_descriptor->parameter.HIGH2_SRC = (uint32_t)(((uint64_t)source_addr >> 32) & 0x3);
     dma_descriptor->parameter.HIGH2_DEST = (uint32_t)(((uint64_t)dest_addr >> 32) & 0x3);
     dma_descriptor->link.full = 0xFFFFF800; // only one memory address
-    printf("after source: %x, %x\n", *(uint32_t *)(&dma_descriptor->source_addr), *(uint32_t *)(&dma_descriptor->dest_addr));
-    printf("parameter: %x\n", *(uint32_t *)(&dma_descriptor->parameter));
-    printf("link: %x\n", *(uint32_t *)(&dma_descriptor->link));
-    /*
-    volatile struct HSTIMER_BGR_REG *hstimer_bgr_reg = (struct HSTIMER_BGR_REG *)(CCU_BASE + 0x073C);
-    volatile uint32_t *mbus_mat_clk_gating_reg = (uint32_t *)(CCU_BASE + 0x804);
-    hstimer_bgr_reg->HSTIMER_RST = 1;
-    hstimer_bgr_reg->HSTIMER_GATING = 1;
-    *mbus_mat_clk_gating_reg = (*mbus_mat_clk_gating_reg) | 1; // gate clock
-    printf("mbus_mat_clk: %p, %x\n", mbus_mat_clk_gating_reg, *mbus_mat_clk_gating_reg);
-    */
     volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
-    // dmac->dmac_channel[0].dmac_desc_addr_regn.full = (uint64_t)dma_descriptor;
     dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT = 1; // autogating off 
-    printf("dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT: %p, %x\n", &dmac->dmac_auto_gate_reg, *(uint32_t *) &dmac->dmac_auto_gate_reg);
-    printf("descriptor: %p, %x\n", dma_descriptor, *(uint32_t *) dma_descriptor);
-    /*
-    uint32_t low_addr_bytes = (uint64_t)dma_descriptor;
-    printf("dma channel 0: %p\n", &dmac->dmac_channel[0]);
-    dmac->dmac_channel[0].dmac_desc_addr_regn.parts.DMA_DESC_ADDR = low_addr_bytes; 
-    dmac->dmac_channel[0].dmac_desc_addr_regn.parts.DMA_DESC_HIGH_ADDR = (uint64_t)dma_descriptor >> 30;
-    printf("high bits: %x\n", dmac->dmac_channel[0].dmac_desc_addr_regn.full & 0x3);
-    */
-    // dmac->dmac_channel[0].dmac_desc_addr_regn.full = (uint64_t)dma_descriptor;
-    dmac->dmac_channel[0].dmac_desc_addr_regn = (uint64_t)dma_descriptor;
-    /*
-    do{
-        printf("dma channel 0 dmac_desc_addr_regn.full: %p, %x\n", &dmac->dmac_channel[0].dmac_desc_addr_regn.full, dmac->dmac_channel[0].dmac_desc_addr_regn.full);
-        if(dmac->dmac_channel[0].dmac_desc_addr_regn.parts.DMA_DESC_ADDR == low_addr_bytes) {
-    //    if(dmac->dmac_channel[0].dmac_desc_addr_regn.full == (uint64_t)dma_descriptor) {
-            break;
-        }
-    } while(1);
-    */
-
-    // dmac->dmac_irq_en_reg0.DMA0_QUEUE_IRQ_EN = 1;
-    // dmac->dmac_irq_en_reg0.DMA0_PKG_IRQ_EN = 1;
-    /*
-    while (1) {
-    printf("dmac_cfg_regn: %x\n", *(uint32_t *)(&dmac->dmac_channel[0].dmac_cfg_regn));
-    }
-    */
+    dmac->dmac_channel[module.dac_channel].dmac_desc_addr_regn = (uint64_t)dma_descriptor;
 
     return dma_descriptor;
 }
 
+static void oneshot_begin(int channel);
+
 void dma_start() {
+    if (module.dac_channel < 0) {
+        return;     // dma_init failed
+    }
     volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    oneshot_begin(module.dac_channel);
     dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT = 0; // autogating on 
-    printf("dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT: %p, %x\n", &dmac->dmac_auto_gate_reg, *(uint32_t *) &dmac->dmac_auto_gate_reg);
-    dmac->dmac_channel[0].dmac_en_regn.DMA_EN = 1;
-    printf("dmac_channel[0].dmac_en_regn.DMA_EN: %p, %x\n", &dmac->dmac_channel[0].dmac_en_regn, *(uint32_t *) &dmac->dmac_channel[0].dmac_en_regn);
+    volatile struct DMAC_CHANNEL *chan = &dmac->dmac_channel[module.dac_channel];
+    chan->dmac_en_regn.DMA_EN = 1;
 }
 
 void dma_disable(int channel) {
+    if (channel < 0 || channel >= DMA_NUM_CHANNELS) {
+        return;
+    }
     volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
     dmac->dmac_channel[channel].dmac_en_regn.DMA_EN = 0;
 }
@@ -105,10 +177,32 @@ int dma_complete(int channel) {
     return !status;
 }
 
+void dma_restart(int channel, struct DMA_DESCRIPTOR *dma_descriptor, const volatile void *mem_addr, uint32_t byte_count) {
+    uint64_t addr = (uint64_t)mem_addr;
+    if (dma_descriptor->config.DMA_SRC_ADDR_MODE == 0) {
+        // memory -> fifo
+        dma_descriptor->source_addr = (uint32_t)(addr & 0xffffffff);
+        dma_descriptor->parameter.HIGH2_SRC = (uint32_t)((addr >> 32) & 0x3);
+    } else {
+        // fifo -> memory
+        dma_descriptor->dest_addr = (uint32_t)(addr & 0xffffffff);
+        dma_descriptor->parameter.HIGH2_DEST = (uint32_t)((addr >> 32) & 0x3);
+    }
+    dma_descriptor->byte_count = byte_count;
+
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    dmac->dmac_channel[channel].dmac_en_regn.DMA_EN = 0;
+    dmac->dmac_channel[channel].dmac_desc_addr_regn = (uint64_t)dma_descriptor;
+    dmac->dmac_channel[channel].dmac_en_regn.DMA_EN = 1;
+}
+
 struct DMA_DESCRIPTOR *dma_mic_init(volatile void *source_addr, void *dest_addr, uint32_t byte_count) {
-    // use channel 1 for mic (b/c we might be using channel 0 for audio output)
-    struct DMA_DESCRIPTOR *dma_descriptor = malloc(sizeof(struct DMA_DESCRIPTOR));
-    printf("sizeof(struct DMA_DESCRIPTOR): %ld\n", sizeof(struct DMA_DESCRIPTOR));
+    // the mic gets its own channel so it can run alongside audio output
+    if (!claim_oneshot(&module.mic_channel, &module.mic_desc)) {
+        printf("dma: no channel or descriptor free for the mic\n");
+        return NULL;
+    }
+    struct DMA_DESCRIPTOR *dma_descriptor = module.mic_desc;
     dma_descriptor->config.DMA_SRC_DRQ_TYPE = 5;
     dma_descriptor->config.DMA_SRC_BLOCK_SIZE = 0;
     dma_descriptor->config.DMA_SRC_ADDR_MODE = 1;
@@ -118,33 +212,265 @@ struct DMA_DESCRIPTOR *dma_mic_init(volatile void *source_addr, void *dest_addr,
     dma_descriptor->config.DMA_DEST_ADDR_MODE = 0;
     dma_descriptor->config.DMA_DEST_DATA_WIDTH = 2;
     dma_descriptor->config.BMODE_SEL = 0;
-    printf("before source: %p\n", source_addr);
-    printf("before dest:   %p\n", dest_addr);
     dma_descriptor->source_addr = (uint32_t)((uint64_t)source_addr & 0xffffffff);
     dma_descriptor->dest_addr = (uint32_t)((uint64_t)dest_addr & 0xffffffff);
     dma_descriptor->byte_count = byte_count;
-    printf("byte count: %d\n", dma_descriptor->byte_count);
     dma_descriptor->parameter.WAIT_CLOCK_CYCLES = 0;
     dma_descriptor->parameter.HIGH2_SRC = (uint32_t)(((uint64_t)source_addr >> 32) & 0x3);
     dma_descriptor->parameter.HIGH2_DEST = (uint32_t)(((uint64_t)dest_addr >> 32) & 0x3);
     dma_descriptor->link.full = 0xFFFFF800; // only one memory address
-    printf("after source: %x, %x\n", *(uint32_t *)(&dma_descriptor->source_addr), *(uint32_t *)(&dma_descriptor->dest_addr));
-    printf("parameter: %x\n", *(uint32_t *)(&dma_descriptor->parameter));
-    printf("link: %x\n", *(uint32_t *)(&dma_descriptor->link));
     volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
     dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT = 1; // autogating off 
-    printf("dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT: %p, %x\n", &dmac->dmac_auto_gate_reg, *(uint32_t *) &dmac->dmac_auto_gate_reg);
-    printf("descriptor: %p, %x\n", dma_descriptor, *(uint32_t *) dma_descriptor);
-    dmac->dmac_channel[1].dmac_desc_addr_regn = (uint64_t)dma_descriptor;
+    dmac->dmac_channel[module.mic_channel].dmac_desc_addr_regn = (uint64_t)dma_descriptor;
 
     return dma_descriptor;
 }
 
 void dma_mic_start() {
+    if (module.mic_channel < 0) {
+        return;     // dma_mic_init failed
+    }
     volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    oneshot_begin(module.mic_channel);
     dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT = 0; // autogating on 
-    printf("dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT: %p, %x\n", &dmac->dmac_auto_gate_reg, *(uint32_t *) &dmac->dmac_auto_gate_reg);
-    dmac->dmac_channel[1].dmac_en_regn.DMA_EN = 1;
-    printf("dmac_channel[1].dmac_en_regn.DMA_EN: %p, %x\n", &dmac->dmac_channel[1].dmac_en_regn, *(uint32_t *) &dmac->dmac_channel[1].dmac_en_regn);
-    printf("sizeof(struct DMAC_CHANNEL): %ld\n", sizeof(struct DMAC_CHANNEL));
+    volatile struct DMAC_CHANNEL *chan = &dmac->dmac_channel[module.mic_channel];
+    chan->dmac_en_regn.DMA_EN = 1;
+}
+
+// Descriptor rings
+
+static uint32_t low32(const volatile void *addr) {
+    return (uint32_t)((uint64_t)addr & 0xffffffff);
+}
+
+static uint32_t high2(const volatile void *addr) {
+    return (uint32_t)(((uint64_t)addr >> 32) & 0x3);
+}
+
+// IRQ enable/pending registers hold 8 channels of 4 bits each
+static volatile uint32_t *irq_reg(volatile uint32_t *reg0, int channel) {
+    return reg0 + channel / 8;
+}
+
+static int irq_shift(int channel) {
+    return (channel % 8) * 4;
+}
+
+#ifndef DMA_MOCK
+// Pending bits are write-1-to-clear: write only the bits being acknowledged
+// so other channels' pending IRQs are not lost (tools/dma_mock.c swaps in
+// a version that emulates this on plain memory)
+static void pend_clear(volatile uint32_t *reg, uint32_t bits) {
+    *reg = bits;
+}
+#endif
+
+bool dma_ring_init(dma_ring_t *ring, int channel, dma_dir_t dir, int drq, volatile void *fifo,
+                   void *buffer, int nperiods, uint32_t period_bytes, dma_period_fn_t fn, void *aux) {
+    if (nperiods <= 0 || nperiods % 2 != 0 || channel < 0 || channel >= DMA_NUM_CHANNELS) {
+        return false;
+    }
+    int ndescs = nperiods / 2;
+    struct DMA_DESCRIPTOR *descs = dma_desc_alloc(ndescs);
+    if (!descs) {
+        return false;
+    }
+    ring->channel = channel;
+    ring->dir = dir;
+    ring->buffer = buffer;
+    ring->nperiods = nperiods;
+    ring->period_bytes = period_bytes;
+    ring->descs = descs;
+    ring->next = 0;
+    ring->fn = fn;
+    ring->aux = aux;
+
+    for (int i = 0; i < ndescs; i++) {
+        struct DMA_DESCRIPTOR *d = &ring->descs[i];
+        uint8_t *mem = ring->buffer + 2 * i * period_bytes;
+        const volatile void *src = dir == DMA_TO_DEVICE ? (const volatile void *)mem : fifo;
+        const volatile void *dest = dir == DMA_TO_DEVICE ? fifo : (const volatile void *)mem;
+
+        d->config.DMA_SRC_DRQ_TYPE = dir == DMA_TO_DEVICE ? DMA_DRQ_SDRAM : drq;
+        d->config.DMA_SRC_BLOCK_SIZE = 0;
+        d->config.DMA_SRC_ADDR_MODE = dir == DMA_TO_DEVICE ? 0 : 1;   // io mode on the FIFO side
+        d->config.DMA_SRC_DATA_WIDTH = 2;
+        d->config.DMA_DEST_DRQ_TYPE = dir == DMA_TO_DEVICE ? drq : DMA_DRQ_SDRAM;
+        d->config.DMA_DEST_BLOCK_SIZE = 0;
+        d->config.DMA_DEST_ADDR_MODE = dir == DMA_TO_DEVICE ? 1 : 0;
+        d->config.DMA_DEST_DATA_WIDTH = 2;
+        d->config.BMODE_SEL = 0;
+        d->source_addr = low32(src);
+        d->dest_addr = low32(dest);
+        d->byte_count = 2 * period_bytes;
+        d->parameter.WAIT_CLOCK_CYCLES = 0;
+        d->parameter.HIGH2_SRC = high2(src);
+        d->parameter.HIGH2_DEST = high2(dest);
+        // last descriptor links back to the first
+        d->link.full = low32(&ring->descs[(i + 1) % ndescs]);
+    }
+    return true;
+}
+
+void dma_ring_start(dma_ring_t *ring) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    int ch = ring->channel;
+    uint32_t bits = (DMA_IRQ_HALF | DMA_IRQ_PKG | DMA_IRQ_QUEUE) << irq_shift(ch);
+
+    ring->next = 0;
+    module.rings[ch] = ring;
+    pend_clear(irq_reg((volatile uint32_t *)&dmac->dmac_irq_pend_reg0, ch), bits);
+    volatile uint32_t *en = irq_reg((volatile uint32_t *)&dmac->dmac_irq_en_reg0, ch);
+    *en = (*en & ~bits) | ((DMA_IRQ_HALF | DMA_IRQ_PKG) << irq_shift(ch));
+
+    dmac->dmac_channel[ch].dmac_desc_addr_regn = low32(ring->descs);
+    dmac->dmac_auto_gate_reg.DMA_MCLK_CIRCUIT = 0; // autogating on
+    dmac->dmac_channel[ch].dmac_en_regn.DMA_EN = 1;
+}
+
+void dma_ring_stop(dma_ring_t *ring) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    int ch = ring->channel;
+    uint32_t bits = (DMA_IRQ_HALF | DMA_IRQ_PKG | DMA_IRQ_QUEUE) << irq_shift(ch);
+
+    dmac->dmac_channel[ch].dmac_en_regn.DMA_EN = 0;
+    volatile uint32_t *en = irq_reg((volatile uint32_t *)&dmac->dmac_irq_en_reg0, ch);
+    *en &= ~bits;
+    pend_clear(irq_reg((volatile uint32_t *)&dmac->dmac_irq_pend_reg0, ch), bits);
+    module.rings[ch] = NULL;
+}
+
+void dma_ring_release(dma_ring_t *ring) {
+    if (module.rings[ring->channel] == ring) {
+        dma_ring_stop(ring);
+    }
+    dma_desc_release(ring->descs, ring->nperiods / 2);
+    ring->descs = NULL;
+}
+
+// Period the channel is currently transferring, from its memory-side address
+static int ring_position(const dma_ring_t *ring) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    const volatile struct DMAC_CHANNEL *chan = &dmac->dmac_channel[ring->channel];
+    uint32_t cur = ring->dir == DMA_TO_DEVICE ? chan->DMAC_CUR_SRC_REGN : chan->DMAC_CUR_DEST_REGN;
+    uint32_t offset = cur - low32(ring->buffer);
+    int period = offset / ring->period_bytes;
+    return period < ring->nperiods ? period : 0;
+}
+
+int dma_ring_service(void) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    volatile uint32_t *pend0 = (volatile uint32_t *)&dmac->dmac_irq_pend_reg0;
+    uint32_t pending[2] = {pend0[0], pend0[1]};
+    int delivered = 0;
+
+    for (int ch = 0; ch < DMA_NUM_CHANNELS; ch++) {
+        dma_ring_t *ring = module.rings[ch];
+        uint32_t bits = (pending[ch / 8] >> irq_shift(ch)) & (DMA_IRQ_HALF | DMA_IRQ_PKG);
+        if (!ring || !bits) {
+            continue;
+        }
+        pend_clear(irq_reg(pend0, ch), bits << irq_shift(ch));
+
+        // every period before the one in flight is finished. The same
+        // position with both HALF and PKG pending is a whole lap, not no
+        // progress: a period already delivered by the last service (one
+        // that finished between its clear and its position read) leaves at
+        // most one of the two bits. More than one lap reads as one.
+        int current = ring_position(ring);
+        int count = (current - ring->next + ring->nperiods) % ring->nperiods;
+        if (count == 0 && bits == (DMA_IRQ_HALF | DMA_IRQ_PKG)) {
+            count = ring->nperiods;
+        }
+        for (; count > 0; count--) {
+            int period = ring->next;
+            ring->next = (ring->next + 1) % ring->nperiods;
+            if (ring->fn) {
+                ring->fn(period, ring->aux);
+            }
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+// One-shot completion: the queue IRQ bit marks the end of a transfer's
+// descriptor chain
+
+static void oneshot_begin(int channel) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    uint32_t bit = DMA_IRQ_QUEUE << irq_shift(channel);
+
+    module.in_flight[channel] = true;
+    module.finished[channel] = false;
+    pend_clear(irq_reg((volatile uint32_t *)&dmac->dmac_irq_pend_reg0, channel), bit);
+    *irq_reg((volatile uint32_t *)&dmac->dmac_irq_en_reg0, channel) |= bit;
+}
+
+static void oneshot_service(void) {
+    volatile struct DMA *dmac = (struct DMA *)DMAC_BASE;
+    volatile uint32_t *pend0 = (volatile uint32_t *)&dmac->dmac_irq_pend_reg0;
+
+    for (int ch = 0; ch < DMA_NUM_CHANNELS; ch++) {
+        uint32_t bit = DMA_IRQ_QUEUE << irq_shift(ch);
+        if (!module.in_flight[ch] || !(*irq_reg(pend0, ch) & bit)) {
+            continue;
+        }
+        pend_clear(irq_reg(pend0, ch), bit);
+        module.in_flight[ch] = false;
+        module.finished[ch] = true;
+
+        // dropped if the main loop has let the queue fill (dma_wait still sees it)
+        ringbuf_push(&module.completions, &ch);
+        if (module.handlers[ch]) {
+            module.handlers[ch](ch, module.handler_aux[ch]);
+        }
+    }
+}
+
+#ifndef DMA_MOCK
+// The DMAC's own interrupt line is not one the interrupts module can
+// dispatch, so a high-speed timer tick reads the DMAC pending registers
+// instead. The tick is short next to a stream period.
+static void dma_tick(void *aux) {
+    hstimer_interrupt_clear(HSTIMER1);
+    dma_ring_service();
+    oneshot_service();
+}
+
+void dma_interrupts_init(void) {
+    hstimer_init(HSTIMER1, DMA_SERVICE_US);
+    interrupts_register_handler(INTERRUPT_SOURCE_HSTIMER1, dma_tick, NULL);
+    interrupts_enable_source(INTERRUPT_SOURCE_HSTIMER1);
+    hstimer_enable(HSTIMER1);
+    module.irq_ready = true;
+}
+#endif
+
+bool dma_interrupts_enabled(void) {
+    return module.irq_ready;
+}
+
+void dma_register_handler(int channel, dma_complete_fn_t fn, void *aux) {
+    module.handlers[channel] = fn;
+    module.handler_aux[channel] = aux;
+}
+
+int dma_completion_next(void) {
+    if (!module.irq_ready) {
+        oneshot_service();
+    }
+    int channel;
+    return ringbuf_pop(&module.completions, &channel) ? channel : -1;
+}
+
+void dma_wait(int channel) {
+    while (!module.finished[channel]) {
+        if (module.irq_ready) {
+            dma_wfi();
+        } else {
+            oneshot_service();
+        }
+    }
+    module.finished[channel] = false;
 }
@@ -1,8 +1,12 @@
 #ifndef DMA_H
 #define DMA_H
 #include "stdint.h"
+#include <stdbool.h>
 
+// a host build can point this at a mock register block
+#ifndef DMAC_BASE
 #define DMAC_BASE 0x03002000UL
+#endif
 
 struct DMAC_IRQ_EN_REG0 {
     uint32_t DMA0_HLAF_IRQ_EN : 1;
@@ -268,8 +272,21 @@ struct DMA_DESCRIPTOR {
     DMA_LINK link;
 };
 
+// DMA_SRC/DEST_DATA_WIDTH codes
+typedef enum {
+    DMA_WIDTH_8 = 0,
+    DMA_WIDTH_16 = 1,
+    DMA_WIDTH_32 = 2,
+    DMA_WIDTH_64 = 3,
+} dma_width_t;
+
+// One-shot memory -> I2S2 transfer of 32-bit words
 struct DMA_DESCRIPTOR *dma_init(const void *source_addr, volatile void *dest_addr, uint32_t byte_count);
 
+// Same, moving `width`-sized items (e.g. DMA_WIDTH_16 for packed 16-bit samples)
+struct DMA_DESCRIPTOR *dma_init_width(const void *source_addr, volatile void *dest_addr, uint32_t byte_count,
+                                      dma_width_t width);
+
 struct DMA_DESCRIPTOR *dma_mic_init(volatile void *source_addr, void *dest_addr, uint32_t byte_count);
 
 struct HSTIMER_BGR_REG {
@@ -279,9 +296,140 @@ struct HSTIMER_BGR_REG {
     uint32_t UNUSED2 : 15;
 };
 
+#define DMA_NUM_CHANNELS 16
+#define DMA_DESC_POOL_SIZE 32
+
+/*
+ * Channel allocator: hands out the lowest free channel.
+ *
+ * @return the channel, or -1 if all are in use
+ */
+int dma_channel_request(void);
+void dma_channel_release(int channel);
+
+/*
+ * Descriptor pool: `count` adjacent descriptors from a static, aligned
+ * pool, so starting a transfer does no heap work.
+ *
+ * @return NULL if the pool has no run of `count` free descriptors
+ */
+struct DMA_DESCRIPTOR *dma_desc_alloc(int count);
+void dma_desc_release(struct DMA_DESCRIPTOR *desc, int count);
+
+// Channels used by dma_init/dma_start and dma_mic_init/dma_mic_start
+// (allocated on first use, -1 before that). dma_init and dma_mic_init
+// return NULL if no channel or descriptor is free, and the matching
+// start call then does nothing.
+int dma_dac_channel(void);
+int dma_mic_channel(void);
+
 void dma_start();
 void dma_disable(int channel);
 void dma_mic_start();
 int dma_complete(int channel);
 
+/*
+ * Point the memory side of an already built descriptor at a new buffer
+ * and rerun it on the channel. Used for periodic transfers so each period
+ * reuses the same descriptor.
+ */
+void dma_restart(int channel, struct DMA_DESCRIPTOR *dma_descriptor, const volatile void *mem_addr, uint32_t byte_count);
+
+// DRQ ports (descriptor DMA_SRC_DRQ_TYPE / DMA_DEST_DRQ_TYPE)
+#define DMA_DRQ_SDRAM 1
+#define DMA_DRQ_I2S2 5
+
+// per-channel bits in the IRQ enable and pending registers
+#define DMA_IRQ_HALF (1 << 0)
+#define DMA_IRQ_PKG (1 << 1)
+#define DMA_IRQ_QUEUE (1 << 2)
+
+typedef enum {
+    DMA_TO_DEVICE,      // memory -> peripheral FIFO
+    DMA_FROM_DEVICE,    // peripheral FIFO -> memory
+} dma_dir_t;
+
+typedef void (*dma_period_fn_t)(int period, void *aux);
+
+/*
+ * Circular descriptor ring: streams a buffer of `nperiods` equal periods
+ * to or from a peripheral FIFO forever, without reprogramming the channel.
+ *
+ * Each descriptor covers a pair of periods and links to the next, the last
+ * back to the first. The half-package IRQ fires after the first period of
+ * a pair and the package IRQ after the second. dma_ring_service() then
+ * reads the channel's current address to see how far the transfer has
+ * got, and calls the period callback once for every period finished
+ * since the last service, in order. A service late by a whole lap or
+ * more delivers exactly one lap (nperiods callbacks), so the consumer
+ * sees it fell behind; service at least once a period to lose nothing.
+ */
+typedef struct {
+    int channel;
+    dma_dir_t dir;
+    uint8_t *buffer;
+    int nperiods;               // even
+    uint32_t period_bytes;
+    struct DMA_DESCRIPTOR *descs;  // nperiods / 2, linked in a circle
+    int next;                   // next period expected to complete
+    dma_period_fn_t fn;
+    void *aux;
+} dma_ring_t;
+
+/*
+ * Build the ring's descriptor chain over `buffer` for `channel` (from
+ * dma_channel_request). Descriptors come from the pool.
+ *
+ * @return false if nperiods is not a positive even number or the pool is
+ * exhausted
+ */
+bool dma_ring_init(dma_ring_t *ring, int channel, dma_dir_t dir, int drq, volatile void *fifo,
+                   void *buffer, int nperiods, uint32_t period_bytes, dma_period_fn_t fn, void *aux);
+void dma_ring_start(dma_ring_t *ring);
+void dma_ring_stop(dma_ring_t *ring);
+// Stop the ring if running and return its descriptors to the pool
+void dma_ring_release(dma_ring_t *ring);
+
+/*
+ * Acknowledge pending ring IRQs and run period callbacks. Call from the
+ * DMAC interrupt or poll it at least once per period.
+ *
+ * @return number of periods delivered
+ */
+int dma_ring_service(void);
+
+/*
+ * Completion delivery for one-shot transfers (dma_start, dma_mic_start).
+ *
+ * dma_interrupts_init() starts a HSTIMER1 tick every DMA_SERVICE_US that
+ * acknowledges DMAC pending bits: ring periods go to their callbacks, and
+ * finished one-shot channels go to their registered handler and the
+ * completion queue. Call it after interrupts_init() and before
+ * interrupts_global_enable(). Without it, dma_wait() and
+ * dma_completion_next() fall back to polling the pending registers.
+ */
+#define DMA_SERVICE_US 500
+#define DMA_COMPLETION_QUEUE 16     // power of two (ringbuf.h)
+
+typedef void (*dma_complete_fn_t)(int channel, void *aux);
+
+void dma_interrupts_init(void);
+bool dma_interrupts_enabled(void);
+
+// `fn` runs in interrupt context when `channel` finishes a transfer
+void dma_register_handler(int channel, dma_complete_fn_t fn, void *aux);
+
+// Next finished channel from the completion queue, or -1 if none
+int dma_completion_next(void);
+
+// Sleep (wfi) until `channel` finishes its transfer
+void dma_wait(int channel);
+
+// Idle the core until the next interrupt
+static inline void dma_wfi(void) {
+#ifdef __riscv
+    __asm__ volatile("wfi");
+#endif
+}
+
 #endif
@@ -0,0 +1,353 @@
+/* File: effects.c
+ * ---------------
+ *  Block-based effect chain and the mixer's built-in stages
+ */
+#include "effects.h"
+#include "arena.h"
+#include "printf.h"
+#include "strings.h"
+#include "timer.h"
+
+// timer_get_ticks() runs at 24 MHz
+#define TICKS_PER_SEC 24000000UL
+
+// Stage descriptors for a few chains' worth of stages
+#define EFFECT_POOL_SIZE (4 * EFFECT_CHAIN_MAX_STAGES)
+
+static struct {
+    pool_t stages;
+    bool stages_ready;
+} module;
+
+effect_chain_t *effect_chain_new(int block_size) {
+    if (block_size <= 0 || block_size > EFFECT_MAX_BLOCK) {
+        block_size = EFFECT_MAX_BLOCK;
+    }
+    size_t mark = arena_mark(&audio_arena);
+    effect_chain_t *chain = arena_alloc(&audio_arena, sizeof(effect_chain_t));
+    sample_t *scratch = arena_alloc(&audio_arena, block_size * sizeof(sample_t));
+    if (!chain || !scratch) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    memset(chain, 0, sizeof(effect_chain_t));
+    chain->block_size = block_size;
+    chain->scratch = scratch;
+    chain->output_bits = 16;
+    chain->noise_shape = true;
+    chain->dither_seed = 0x12345678;
+    return chain;
+}
+
+bool effect_chain_insert(effect_chain_t *chain, int index, effect_t *fx) {
+    if (chain->nstages == EFFECT_CHAIN_MAX_STAGES || index < 0 || index > chain->nstages) {
+        return false;
+    }
+    for (int i = chain->nstages; i > index; i--) {
+        chain->stages[i] = chain->stages[i - 1];
+    }
+    chain->stages[index] = fx;
+    chain->nstages++;
+    return true;
+}
+
+bool effect_chain_append(effect_chain_t *chain, effect_t *fx) {
+    return effect_chain_insert(chain, chain->nstages, fx);
+}
+
+effect_t *effect_chain_remove(effect_chain_t *chain, int index) {
+    if (index < 0 || index >= chain->nstages) {
+        return NULL;
+    }
+    effect_t *fx = chain->stages[index];
+    for (int i = index; i < chain->nstages - 1; i++) {
+        chain->stages[i] = chain->stages[i + 1];
+    }
+    chain->nstages--;
+    return fx;
+}
+
+bool effect_chain_move(effect_chain_t *chain, int from, int to) {
+    if (to < 0 || to >= chain->nstages) {
+        return false;
+    }
+    effect_t *fx = effect_chain_remove(chain, from);
+    if (!fx) {
+        return false;
+    }
+    return effect_chain_insert(chain, to, fx);
+}
+
+// Run all stages over one block (n <= block_size)
+static void process_block(effect_chain_t *chain, sample_t *block, int n) {
+    for (int i = 0; i < chain->nstages; i++) {
+        effect_t *fx = chain->stages[i];
+        if (fx->bypass) {
+            continue;
+        }
+        unsigned long start = chain->profile ? timer_get_ticks() : 0;
+        if (fx->prepare) {
+            fx->prepare(fx);
+        }
+        fx->process(fx, block, n);
+        if (chain->profile) {
+            fx->ticks += timer_get_ticks() - start;
+            fx->blocks++;
+        }
+    }
+}
+
+void effect_chain_process(effect_chain_t *chain, sample_t *samples, int n) {
+    for (int start = 0; start < n; start += chain->block_size) {
+        int len = n - start < chain->block_size ? n - start : chain->block_size;
+        process_block(chain, samples + start, len);
+    }
+}
+
+void effect_chain_set_output_bits(effect_chain_t *chain, int bits) {
+    chain->output_bits = bits == 24 ? 24 : 16;
+    chain->dither_error = 0;
+}
+
+static inline uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Q8.24 block -> left-justified words of `bits` bits: TPDF dither of one
+// output LSB peak, optional first-order noise shaping, then round and clip.
+// `out` may alias `in`
+static void requantize(effect_chain_t *chain, const sample_t *in, uint32_t *out, int n, int bits) {
+    int shift = SAMPLE_FRAC_BITS + 1 - bits;   // Q8.24 fraction bits below the output LSB
+    int32_t half = 1 << (shift - 1);
+    int32_t max = (1 << (bits - 1)) - 1;
+    int32_t min = -max - 1;
+    uint32_t lsb_mask = (1u << shift) - 1;
+    uint32_t seed = chain->dither_seed;
+    int32_t error = chain->noise_shape ? chain->dither_error : 0;
+
+    for (int i = 0; i < n; i++) {
+        // two uniform values of one LSB each: triangular, zero mean
+        uint32_t r = xorshift32(&seed);
+        int32_t dither = (int32_t)(r & lsb_mask) - (int32_t)((r >> 16) & lsb_mask);
+        int64_t target = (int64_t)in[i] - error;
+        int64_t q = (target + dither + half) >> shift;
+        if (q > max) q = max;
+        if (q < min) q = min;
+        if (chain->noise_shape) {
+            int64_t e = (q << shift) - target;
+            // a clipped sample would feed back a huge error: cap it to one LSB
+            error = e > (int64_t)lsb_mask ? (int32_t)lsb_mask : e < -(int64_t)lsb_mask ? -(int32_t)lsb_mask : (int32_t)e;
+        }
+        out[i] = (uint32_t)q << (32 - bits);
+    }
+    chain->dither_seed = seed;
+    chain->dither_error = error;
+}
+
+void effect_chain_process_words(effect_chain_t *chain, uint32_t *words, int n) {
+    for (int start = 0; start < n; start += chain->block_size) {
+        int len = n - start < chain->block_size ? n - start : chain->block_size;
+        uint32_t *w = words + start;
+        audio_convert_word32_to_q24(w, chain->scratch, len);
+        process_block(chain, chain->scratch, len);
+        unsigned long t = chain->profile ? timer_get_ticks() : 0;
+        requantize(chain, chain->scratch, w, len, chain->output_bits);
+        if (chain->profile) {
+            chain->convert_ticks += timer_get_ticks() - t;
+            chain->convert_blocks++;
+        }
+    }
+}
+
+// 16-bit samples in place, through the scratch block
+static void process_s16(effect_chain_t *chain, int16_t *samples, int n) {
+    for (int start = 0; start < n; start += chain->block_size) {
+        int len = n - start < chain->block_size ? n - start : chain->block_size;
+        audio_convert_s16_to_q24(samples + start, chain->scratch, len);
+        process_block(chain, chain->scratch, len);
+        requantize(chain, chain->scratch, (uint32_t *)chain->scratch, len, 16);
+        audio_convert_word32_to_s16((uint32_t *)chain->scratch, samples + start, len);
+    }
+}
+
+bool effect_chain_process_buffer(effect_chain_t *chain, audio_buffer_t *buf) {
+    if (buf->channels != 1) {
+        return false;
+    }
+    switch (buf->format) {
+        case AUDIO_FORMAT_Q24:
+            effect_chain_process(chain, buf->data, buf->frames);
+            break;
+        case AUDIO_FORMAT_WORD32:
+            effect_chain_process_words(chain, buf->data, buf->frames);
+            break;
+        case AUDIO_FORMAT_S16:
+            process_s16(chain, buf->data, buf->frames);
+            break;
+    }
+    return true;
+}
+
+void effect_chain_reset(effect_chain_t *chain) {
+    for (int i = 0; i < chain->nstages; i++) {
+        effect_t *fx = chain->stages[i];
+        if (fx->reset) {
+            fx->reset(fx);
+        }
+    }
+    chain->dither_error = 0;
+}
+
+void effect_chain_report(effect_chain_t *chain) {
+    // real time covered by one block
+    unsigned long block_ticks = TICKS_PER_SEC * chain->block_size / EFFECT_SAMPLE_RATE;
+
+    printf("effect chain (%d-sample blocks, %ld ticks real time):\n", chain->block_size, block_ticks);
+    for (int i = 0; i < chain->nstages; i++) {
+        effect_t *fx = chain->stages[i];
+        unsigned long avg = fx->blocks ? fx->ticks / fx->blocks : 0;
+        int percent = (int)(avg * 100 / block_ticks);
+        printf("  %d %s: %ld ticks/block (%d%%) over %d blocks%s%s\n", i, fx->name, avg, percent, fx->blocks,
+               fx->bypass ? " (bypassed)" : "",
+               fx->budget_percent && percent > fx->budget_percent ? " OVER BUDGET" : "");
+    }
+    if (chain->convert_blocks) {
+        unsigned long avg = chain->convert_ticks / chain->convert_blocks;
+        printf("  requantize to %d bits%s: %ld ticks/block (%d%%)\n", chain->output_bits,
+               chain->noise_shape ? " (shaped)" : "", avg, (int)(avg * 100 / block_ticks));
+    }
+    pool_report(&module.stages);
+}
+
+effect_t *effect_new(const char *name, void *params, void *state) {
+    if (!module.stages_ready) {
+        module.stages_ready = pool_init(&module.stages, "effect stages", &audio_arena, sizeof(effect_t), EFFECT_POOL_SIZE);
+    }
+    effect_t *fx = pool_alloc(&module.stages);
+    if (!fx) {
+        return NULL;
+    }
+    memset(fx, 0, sizeof(effect_t));
+    fx->name = name;
+    fx->params = params;
+    fx->state = state;
+    return fx;
+}
+
+void effect_delete(effect_t *fx) {
+    pool_free(&module.stages, fx);
+}
+
+// Level: multiply (or halve) every sample. Samples are signed and the
+// product saturates; the per-sample levels() this replaced worked on the
+// raw uint16_t sample, so it halved negative samples into positive ones
+// and let gains wrap, and its output differs from this for those.
+
+struct level_state {
+    int mul;
+    int shift;
+};
+
+static void level_prepare(effect_t *fx) {
+    level_params_t *params = fx->params;
+    struct level_state *st = fx->state;
+    if (params->level == -2) {
+        st->mul = 1;
+        st->shift = 1;
+    } else {
+        st->mul = params->level;
+        st->shift = 0;
+    }
+}
+
+static void level_process(effect_t *fx, sample_t *block, int n) {
+    struct level_state *st = fx->state;
+    int mul = st->mul;
+    int shift = st->shift;
+    for (int i = 0; i < n; i++) {
+        block[i] = sample_sat(((int64_t)block[i] * mul) >> shift);
+    }
+}
+
+effect_t *effect_level_new(level_params_t *params) {
+    size_t mark = arena_mark(&audio_arena);
+    struct level_state *st = arena_alloc(&audio_arena, sizeof(struct level_state));
+    effect_t *fx = st ? effect_new("level", params, st) : NULL;
+    if (!fx) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    fx->prepare = level_prepare;
+    fx->process = level_process;
+    return fx;
+}
+
+// Backing track: mix in the next samples of an ADPCM track, decoded one
+// block ahead of the playhead
+
+struct backing_state {
+    const adpcm_asset_t *track;   // asset the stream is attached to
+    bool ready;
+    adpcm_stream_t stream;
+    int16_t decoded[EFFECT_MAX_BLOCK];
+};
+
+// There is no resampler: a track at any other rate would play at the
+// wrong pitch and speed, so it is not attached
+static bool backing_rate_ok(const adpcm_asset_t *track) {
+    return track->sample_rate == EFFECT_SAMPLE_RATE;
+}
+
+static void backing_prepare(effect_t *fx) {
+    backing_params_t *params = fx->params;
+    struct backing_state *st = fx->state;
+
+    if (params->track != st->track) {
+        st->track = params->track;
+        st->ready = st->track && backing_rate_ok(st->track) &&
+                    adpcm_stream_init(&st->stream, st->track, params->at_end);
+    }
+    st->stream.at_end = params->at_end;
+}
+
+static void backing_process(effect_t *fx, sample_t *block, int n) {
+    struct backing_state *st = fx->state;
+    if (!st->ready) {
+        return;
+    }
+    adpcm_stream_read(&st->stream, st->decoded, n);
+    for (int i = 0; i < n; i++) {
+        block[i] = sample_add(block[i], sample_from_i16(st->decoded[i]));
+    }
+}
+
+effect_t *effect_backing_new(backing_params_t *params) {
+    size_t mark = arena_mark(&audio_arena);
+    struct backing_state *st = arena_alloc(&audio_arena, sizeof(struct backing_state));
+    effect_t *fx = st ? effect_new("backing", params, st) : NULL;
+    if (!fx) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    st->track = NULL;
+    st->ready = false;
+    if (params->track && !backing_rate_ok(params->track)) {
+        printf("backing: track is %d Hz but the chain runs at %d Hz, it will not play\n",
+               params->track->sample_rate, EFFECT_SAMPLE_RATE);
+    }
+    fx->prepare = backing_prepare;
+    fx->process = backing_process;
+    fx->reset = effect_backing_rewind;
+    return fx;
+}
+
+void effect_backing_rewind(effect_t *fx) {
+    struct backing_state *st = fx->state;
+    if (st->ready) {
+        adpcm_stream_rewind(&st->stream);
+    }
+}
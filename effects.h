@@ -0,0 +1,152 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "adpcm.h"
+#include "audio_buffer.h"
+
+/*
+ * Block-based effect chain.
+ *
+ * Each stage processes a block of samples at a time. A stage's prepare()
+ * reads its parameters once per block, so process() runs a tight loop
+ * with no per-sample branching on settings. Stages can be inserted,
+ * removed and reordered while audio is running.
+ */
+
+/*
+ * Samples are Q8.24: full scale (a 16-bit sample's -32768..32767) maps to
+ * -1.0..1.0 = +-(1 << 24), leaving 7 bits of headroom above full scale.
+ * Stages saturate instead of wrapping; only the final requantization in
+ * effect_chain_process_words() clips to the output word.
+ */
+typedef int32_t sample_t;
+
+#define SAMPLE_FRAC_BITS 24
+#define SAMPLE_ONE (1 << SAMPLE_FRAC_BITS)
+
+static inline sample_t sample_sat(int64_t v) {
+    return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (sample_t)v;
+}
+
+static inline sample_t sample_add(sample_t a, sample_t b) {
+    return sample_sat((int64_t)a + b);
+}
+
+static inline sample_t sample_from_i16(int16_t s) {
+    return (sample_t)s << (SAMPLE_FRAC_BITS - 15);
+}
+
+#define EFFECT_SAMPLE_RATE 44100
+#define EFFECT_MAX_BLOCK 256
+#define EFFECT_CHAIN_MAX_STAGES 8
+
+typedef struct effect effect_t;
+
+struct effect {
+    const char *name;
+    void (*prepare)(effect_t *fx);                          // once per block
+    void (*process)(effect_t *fx, sample_t *block, int n);  // n <= EFFECT_MAX_BLOCK
+    void (*reset)(effect_t *fx);                            // optional: forget past audio
+    void *params;   // caller-owned settings, read in prepare()
+    void *state;    // stage-owned coefficients and memory
+    bool bypass;
+
+    // profiling (see effect_chain_report)
+    unsigned long ticks;
+    unsigned int blocks;
+    int budget_percent;   // share of real time allowed per block, 0 = none
+};
+
+typedef struct {
+    effect_t *stages[EFFECT_CHAIN_MAX_STAGES];
+    int nstages;
+    int block_size;
+    sample_t *scratch;  // one block, owned by the chain
+    bool profile;
+
+    // requantization to FIFO words (see effect_chain_process_words)
+    int output_bits;        // 16 (default) or 24
+    bool noise_shape;       // first-order error feedback on top of TPDF dither
+    uint32_t dither_seed;
+    int32_t dither_error;   // last quantization error, Q8.24
+    unsigned long convert_ticks;
+    unsigned int convert_blocks;
+} effect_chain_t;
+
+// NULL if the audio arena is full
+effect_chain_t *effect_chain_new(int block_size);
+
+/*
+ * Insert a stage before position `index` (nstages appends).
+ *
+ * @return false if the chain is full or the index is out of range
+ */
+bool effect_chain_insert(effect_chain_t *chain, int index, effect_t *fx);
+bool effect_chain_append(effect_chain_t *chain, effect_t *fx);
+effect_t *effect_chain_remove(effect_chain_t *chain, int index);
+bool effect_chain_move(effect_chain_t *chain, int from, int to);
+
+/*
+ * Run every stage over `samples` in place, block_size samples at a time.
+ */
+void effect_chain_process(effect_chain_t *chain, sample_t *samples, int n);
+
+/*
+ * Process 32-bit left-justified FIFO words in place, one block at a time
+ * through the chain's scratch block. The full 32-bit input is kept (as
+ * Q8.24), and the result is requantized to output_bits with TPDF dither
+ * and written back left-justified, so the buffer can be handed straight
+ * to playback DMA.
+ */
+void effect_chain_process_words(effect_chain_t *chain, uint32_t *words, int n);
+
+/*
+ * Process a mono buffer in place in whatever format it holds: Q24 runs
+ * straight through, WORD32 as effect_chain_process_words, and S16 is
+ * widened a block at a time and requantized (dithered) back to 16 bits.
+ *
+ * @return false for multi-channel buffers
+ */
+bool effect_chain_process_buffer(effect_chain_t *chain, audio_buffer_t *buf);
+
+// Word depth produced by effect_chain_process_words: 16 or 24 bits
+void effect_chain_set_output_bits(effect_chain_t *chain, int bits);
+
+// Reset every stage (reverb tails, envelopes, track positions) and the
+// dither state, so the next take does not hear the previous one
+void effect_chain_reset(effect_chain_t *chain);
+
+// Print average timer ticks per block for each stage, and flag stages
+// that use more of the block's real time than their budget
+void effect_chain_report(effect_chain_t *chain);
+
+// For stage implementations: allocate a zeroed stage from the stage pool,
+// or NULL if the pool is full
+effect_t *effect_new(const char *name, void *params, void *state);
+
+// Return a stage (removed from its chain) to the pool. Its state is in
+// the audio arena and is only reclaimed when that arena is reset.
+void effect_delete(effect_t *fx);
+
+// Built-in stages. Every stage constructor (here, compressor.h, reverb.h,
+// looper.h) returns NULL, taking nothing from the audio arena, if the
+// arena or the stage pool is full.
+
+typedef struct {
+    int level;          // 0 mutes, -2 halves, otherwise multiplies (UI knob values)
+} level_params_t;
+
+typedef struct {
+    const adpcm_asset_t *track;  // NULL for none; not played unless at EFFECT_SAMPLE_RATE
+    adpcm_end_t at_end;          // loop, or play once then silence
+} backing_params_t;
+
+effect_t *effect_level_new(level_params_t *params);
+effect_t *effect_backing_new(backing_params_t *params);
+
+// Restart the backing track from its first sample, also after it has stopped
+void effect_backing_rewind(effect_t *fx);
+
+#endif
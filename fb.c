@@ -3,9 +3,10 @@
  *  Framebuffer implementation
  */
 #include "fb.h"
+#include "fb_extra.h"
 #include "de.h"
 #include "hdmi.h"
-#include "malloc.h"
+#include "arena.h"
 #include "strings.h"
 
 // module-level variables, you may add/change this struct as you see fit
@@ -19,28 +20,27 @@ static struct {
     void *framebuffer[2];  // address of framebuffer memory
 
     int active_buffer;     // index of active buffer
+
+    fb_rect_t damage[2];   // changed in each buffer while it was the draw buffer
 } module;
 
 void fb_init(int width, int height, fb_mode_t mode) {
-    // Free previously allocated memory
-    if (module.framebuffer[0] != NULL) {
-        free(module.framebuffer[0]);
-        module.framebuffer[0] = NULL;
-    }
-    if (module.framebuffer[1] != NULL) {
-        free(module.framebuffer[1]);
-        module.framebuffer[1] = NULL;
-    }
+    // Everything in the graphics arena hangs off the previous framebuffers,
+    // so drop it all in one go instead of freeing piece by piece
+    arena_reset(&graphics_arena);
+    module.framebuffer[0] = NULL;
+    module.framebuffer[1] = NULL;
 
     module.width = width;
     module.height = height;
     module.depth = 4;
     module.mode = mode;
     module.active_buffer = 0;
+    module.damage[0] = module.damage[1] = (fb_rect_t){0};
     int nbytes = module.width * module.height * module.depth;
 
-    // Allocate memory for framebuffers
-    module.framebuffer[0] = malloc(nbytes);
+    // Allocate memory for framebuffers (cache-line aligned for the DE)
+    module.framebuffer[0] = arena_alloc(&graphics_arena, nbytes);
 
     if (!module.framebuffer[0]) {
         // Handle allocation failure
@@ -51,10 +51,10 @@ void fb_init(int width, int height, fb_mode_t mode) {
 
     // doublebuffer mode
     if (mode == FB_DOUBLEBUFFER) {
-        module.framebuffer[1] = malloc(nbytes);
+        module.framebuffer[1] = arena_alloc(&graphics_arena, nbytes);
         if (!module.framebuffer[1]) {
             // If allocation fails
-            free(module.framebuffer[0]);
+            arena_reset(&graphics_arena);
             module.framebuffer[0] = NULL;
             return;
         }
@@ -79,6 +79,51 @@ int fb_get_depth(void) {
     return module.depth;
 }
 
+static int draw_index(void) {
+    return module.mode == FB_DOUBLEBUFFER ? 1 - module.active_buffer : 0;
+}
+
+void fb_damage(int x, int y, int w, int h) {
+    // clip to the screen
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > module.width ? module.width : x + w;
+    int y1 = y + h > module.height ? module.height : y + h;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // grow the bounding box
+    fb_rect_t *d = &module.damage[draw_index()];
+    if (d->w > 0 && d->h > 0) {
+        if (d->x < x0) x0 = d->x;
+        if (d->y < y0) y0 = d->y;
+        if (d->x + d->w > x1) x1 = d->x + d->w;
+        if (d->y + d->h > y1) y1 = d->y + d->h;
+    }
+    *d = (fb_rect_t){ .x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0 };
+}
+
+fb_rect_t fb_get_damage(void) {
+    return module.damage[draw_index()];
+}
+
+// Copy rect r of buffer `from` into buffer `to`, row by row (one block
+// if the rows span the full width and so are contiguous)
+static void copy_rect(int to, int from, fb_rect_t r) {
+    int pitch = module.width * module.depth;
+    int offset = r.y * pitch + r.x * module.depth;
+    unsigned char *dst = (unsigned char *)module.framebuffer[to] + offset;
+    const unsigned char *src = (const unsigned char *)module.framebuffer[from] + offset;
+    if (r.w == module.width) {
+        memcpy(dst, src, r.h * pitch);
+    } else {
+        for (int row = 0; row < r.h; row++) {
+            memcpy(dst + row * pitch, src + row * pitch, r.w * module.depth);
+        }
+    }
+}
+
 void* fb_get_draw_buffer(void) {
     if (module.mode == FB_DOUBLEBUFFER) {
         // return address if double
@@ -91,5 +136,17 @@ void fb_swap_buffer(void) {
     if (module.mode == FB_DOUBLEBUFFER) {
         module.active_buffer = 1 - module.active_buffer;
         de_set_active_framebuffer(module.framebuffer[module.active_buffer]);
+
+        // Bring the new draw buffer up to date with the frame just shown,
+        // copying only what that frame changed, so drawing can carry on
+        // from the screen contents instead of repainting everything
+        int shown = module.active_buffer;
+        fb_rect_t r = module.damage[shown];
+        if (r.w > 0 && r.h > 0) {
+            copy_rect(1 - shown, shown, r);
+        }
+        module.damage[shown] = (fb_rect_t){0};
+    } else {
+        module.damage[0] = (fb_rect_t){0};
     }
 }
@@ -0,0 +1,29 @@
+#ifndef FB_EXTRA_H
+#define FB_EXTRA_H
+
+#include "fb.h"
+
+/*
+ * Damage tracking for partial redraw, alongside the functions in fb.h.
+ *
+ * Drawing code reports each region of the draw buffer it changes with
+ * fb_damage(); gl.c does this for every primitive. fb keeps the union of
+ * those regions per buffer. In double-buffered mode, fb_swap_buffer()
+ * then copies just that union from the buffer going on screen into the
+ * new draw buffer, so the two buffers stay identical and the next frame
+ * only has to repaint what changes, instead of clearing and redrawing
+ * everything into a buffer two frames out of date.
+ */
+
+typedef struct {
+    int x, y;       // top left
+    int w, h;       // empty if either is zero
+} fb_rect_t;
+
+// Mark a region of the draw buffer as changed (clipped to the screen)
+void fb_damage(int x, int y, int w, int h);
+
+// Union of the regions changed in the draw buffer since the last swap
+fb_rect_t fb_get_damage(void);
+
+#endif
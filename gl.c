@@ -3,13 +3,54 @@
  *  gl implementation + draw_line + triangle (retest)
  */
 #include "gl.h"
+#include "fb_extra.h"
+#include "gl_extra.h"
 #include "font.h"
+#include <stdint.h>
 
 // Static global variables for gl
 static int gl_width;
 static int gl_height;
 static int gl_depth;
 
+// Glyph atlas: bit j of rows[ch][i] is pixel j of row i of the glyph for
+// ch, for 7-bit ASCII (anything without a glyph is all zeros)
+#define ATLAS_GLYPHS 128
+#define ATLAS_MAX_WIDTH 32
+#define ATLAS_MAX_HEIGHT 32
+
+static struct {
+    bool ready;     // the font fits; otherwise text is drawn from the font directly
+    int width, height;
+    uint32_t rows[ATLAS_GLYPHS][ATLAS_MAX_HEIGHT];
+} atlas;
+
+// Expand the font into the atlas, once: a font lookup unpacks a whole
+// glyph, far too slow to do per character drawn
+static void build_atlas(void) {
+    atlas.width = font_get_glyph_width();
+    atlas.height = font_get_glyph_height();
+    atlas.ready = atlas.width <= ATLAS_MAX_WIDTH && atlas.height <= ATLAS_MAX_HEIGHT;
+    if (!atlas.ready) {
+        return;
+    }
+
+    int glyph_size = font_get_glyph_size();
+    unsigned char glyph[glyph_size];
+    for (int ch = 0; ch < ATLAS_GLYPHS; ch++) {
+        bool found = font_get_glyph(ch, glyph, glyph_size);
+        for (int i = 0; i < atlas.height; i++) {
+            uint32_t bits = 0;
+            for (int j = 0; found && j < atlas.width; j++) {
+                if (glyph[i * atlas.width + j] == 0xFF) { // On pixel
+                    bits |= 1u << j;
+                }
+            }
+            atlas.rows[ch][i] = bits;
+        }
+    }
+}
+
 void gl_init(int width, int height, gl_mode_t mode) {
     fb_init(width, height, mode);
 
@@ -17,6 +58,10 @@ void gl_init(int width, int height, gl_mode_t mode) {
     gl_width = width;
     gl_height = height;
     gl_depth = fb_get_depth();
+
+    if (!atlas.ready) {
+        build_atlas();
+    }
 }
 
 int gl_get_width(void) {
@@ -36,41 +81,53 @@ void gl_swap_buffer(void) {
     fb_swap_buffer();
 }
 
-void gl_clear(color_t c) {
-    int nbytes = gl_width * gl_height * gl_depth;
-    unsigned char *buffer = fb_get_draw_buffer();
-    unsigned char *pixel = (unsigned char *)&c;
-
-    for (int i = 0; i < nbytes; i += 4) {
-        // blue
-        buffer[i] = pixel[0];     
-        // green
-        buffer[i + 1] = pixel[1];
-        // red
-        buffer[i + 2] = pixel[2];
-        // alpha
-        buffer[i + 3] = pixel[3];
+// Fill n pixels from `span` with c: one 32-bit store to reach 8-byte
+// alignment, then 64-bit stores (two pixels each) unrolled by four
+static void fill_span(uint32_t *span, int n, color_t c) {
+    if (n > 0 && ((uintptr_t)span & 7) != 0) {
+        *span++ = c;
+        n--;
+    }
+    uint64_t pair = ((uint64_t)c << 32) | c;
+    uint64_t *wide = (uint64_t *)span;
+    int npairs = n / 2;
+    int i = 0;
+    for (; i + 4 <= npairs; i += 4) {
+        wide[i] = pair;
+        wide[i + 1] = pair;
+        wide[i + 2] = pair;
+        wide[i + 3] = pair;
+    }
+    for (; i < npairs; i++) {
+        wide[i] = pair;
+    }
+    if (n & 1) {
+        span[n - 1] = c;
     }
 }
 
-void gl_draw_pixel(int x, int y, color_t c) {
+void gl_clear(color_t c) {
+    fb_damage(0, 0, gl_width, gl_height);
+    // the draw buffer is one contiguous span of width * height pixels
+    fill_span(fb_get_draw_buffer(), gl_width * gl_height, c);
+}
+
+// Store one pixel, without damage tracking: callers report the bounding
+// box of everything they draw once
+static inline void put_pixel(int x, int y, color_t c) {
     // within bounds
     if (x < 0 || x >= gl_width || y < 0 || y >= gl_height) {
         return;
     }
 
-    unsigned char *buffer = (unsigned char *)fb_get_draw_buffer();
-    int offset = (y * gl_width + x) * gl_depth;
-    unsigned char *pixel = (unsigned char *)&c;
+    // BGRA in memory is a color_t in one little-endian word
+    uint32_t *buffer = fb_get_draw_buffer();
+    buffer[y * gl_width + x] = c;
+}
 
-    // blue
-    buffer[offset] = pixel[0];     
-    // green
-    buffer[offset + 1] = pixel[1];
-    // red  
-    buffer[offset + 2] = pixel[2];
-    // alpha
-    buffer[offset + 3] = pixel[3];
+void gl_draw_pixel(int x, int y, color_t c) {
+    fb_damage(x, y, 1, 1);
+    put_pixel(x, y, c);
 }
 
 color_t gl_read_pixel(int x, int y) {
@@ -79,32 +136,83 @@ color_t gl_read_pixel(int x, int y) {
         return 0;
     }
 
-    unsigned char *buffer = (unsigned char *)fb_get_draw_buffer();
-    int offset = (y * gl_width + x) * gl_depth;
-    unsigned char pixel[4];
+    uint32_t *buffer = fb_get_draw_buffer();
+    return buffer[y * gl_width + x];
+}
 
-    // blue
-    pixel[0] = buffer[offset];     
-    // green
-    pixel[1] = buffer[offset + 1];
-    // red
-    pixel[2] = buffer[offset + 2];
-    // alpha
-    pixel[3] = buffer[offset + 3];
+void gl_draw_rect(int x, int y, int w, int h, color_t c) {
+    // clip to the framebuffer once, instead of per pixel
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > gl_width ? gl_width : x + w;
+    int y1 = y + h > gl_height ? gl_height : y + h;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    fb_damage(x0, y0, x1 - x0, y1 - y0);
 
-    return *(color_t *)pixel;
+    uint32_t *buffer = fb_get_draw_buffer();
+    if (x0 == 0 && x1 == gl_width) {
+        // full-width rows are contiguous: one span for the whole rect
+        fill_span(buffer + y0 * gl_width, (y1 - y0) * gl_width, c);
+        return;
+    }
+    for (int row = y0; row < y1; row++) {
+        fill_span(buffer + row * gl_width + x0, x1 - x0, c);
+    }
 }
 
-void gl_draw_rect(int x, int y, int w, int h, color_t c) {
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            // call pixel to discard invalid pixels
-            gl_draw_pixel(x + i, y + j, c);
+// Blit n characters from the atlas left to right from x, y, a pixel row at
+// a time across the whole run. Clipping is per run, except for masking
+// the glyphs that straddle the left or right edge
+static void blit_glyphs(int x, int y, const char *chars, int n, color_t c) {
+    int w = atlas.width;
+    int row0 = y < 0 ? -y : 0;
+    int row1 = y + atlas.height > gl_height ? gl_height - y : atlas.height;
+    if (n <= 0 || row0 >= row1 || x >= gl_width || x + n * w <= 0) {
+        return;
+    }
+    // glyphs at least partly on screen
+    int first = x < 0 ? -x / w : 0;
+    int last = (gl_width - x + w - 1) / w;
+    if (last > n) {
+        last = n;
+    }
+    fb_damage(x + first * w, y, (last - first) * w, atlas.height);
+
+    uint32_t *buffer = fb_get_draw_buffer();
+    for (int row = row0; row < row1; row++) {
+        uint32_t *line = buffer + (y + row) * gl_width;
+        for (int i = first; i < last; i++) {
+            unsigned char ch = chars[i];
+            if (ch >= ATLAS_GLYPHS) {
+                continue;
+            }
+            uint32_t bits = atlas.rows[ch][row];
+            int gx = x + i * w;
+            if (gx < 0) {
+                bits >>= -gx;
+                gx = 0;
+            }
+            if (gx + w > gl_width) {
+                bits &= (1u << (gl_width - gx)) - 1;
+            }
+            // stops at the last lit pixel; a space stores nothing
+            for (uint32_t *dst = line + gx; bits; bits >>= 1, dst++) {
+                if (bits & 1) {
+                    *dst = c;
+                }
+            }
         }
     }
 }
 
 void gl_draw_char(int x, int y, char ch, color_t c) {
+    if (atlas.ready) {
+        blit_glyphs(x, y, &ch, 1, c);
+        return;
+    }
+
     // glyph parameters
     int glyph_width = font_get_glyph_width();
     int glyph_height = font_get_glyph_height();
@@ -115,22 +223,64 @@ void gl_draw_char(int x, int y, char ch, color_t c) {
     if (!font_get_glyph(ch, glyph, glyph_size)) {
         return;
     }
+    fb_damage(x, y, glyph_width, glyph_height);
 
     for (int i = 0; i < glyph_height; i++) {
         for (int j = 0; j < glyph_width; j++) {
             if (glyph[i * glyph_width + j] == 0xFF) { // On pixel
-                gl_draw_pixel(x + j, y + i, c);
+                put_pixel(x + j, y + i, c);
             }
         }
     }
 }
 
+void gl_draw_chars(int x, int y, const char *chars, int n, color_t c) {
+    if (atlas.ready) {
+        blit_glyphs(x, y, chars, n, c);
+        return;
+    }
+
+    int char_width = gl_get_char_width();
+    for (int i = 0; i < n; i++) {
+        gl_draw_char(x, y, chars[i], c);
+        x += char_width;
+    }
+}
+
 void gl_draw_string(int x, int y, const char* str, color_t c) {
+    int n = 0;
+    while (str[n]) {
+        n++;
+    }
+    gl_draw_chars(x, y, str, n, c);
+}
+
+void gl_text_layout(gl_text_t *text, const char *str, int x, int y, int width, int line_height) {
     int char_width = gl_get_char_width();
+    int max_chars_per_line = width / char_width > 0 ? width / char_width : 1;
 
-    while (*str) {
-        gl_draw_char(x, y, *str++, c);
-        x += char_width;
+    text->source = str;
+    int n = 0;
+    while (str[n] && n < GL_TEXT_MAX_CHARS) {
+        text->chars[n] = str[n];
+        n++;
+    }
+
+    // fixed-width lines, each centered in the band
+    text->nlines = 0;
+    for (int start = 0; start < n && text->nlines < GL_TEXT_MAX_LINES; start += max_chars_per_line) {
+        int len = n - start < max_chars_per_line ? n - start : max_chars_per_line;
+        text->lines[text->nlines].x = x + (width - len * char_width) / 2;
+        text->lines[text->nlines].y = y + text->nlines * line_height;
+        text->lines[text->nlines].start = start;
+        text->lines[text->nlines].len = len;
+        text->nlines++;
+    }
+}
+
+void gl_draw_text(const gl_text_t *text, color_t c) {
+    for (int i = 0; i < text->nlines; i++) {
+        gl_draw_chars(text->lines[i].x, text->lines[i].y, text->chars + text->lines[i].start, text->lines[i].len, c);
     }
 }
 
@@ -149,45 +299,38 @@ static int abs(int x) {
     return x < 0 ? -x : x;
 }
 
-static float round(float x) {
-    return x >= 0.0f ? (int)(x + 0.5f) : (int)(x - 0.5f);
-}
+// Line coverage is 16.16 fixed point
+#define WU_FRAC_BITS 16
+#define WU_ONE (1 << WU_FRAC_BITS)
 
-static float fmod(float x, float y) {
-    return x - (int)(x / y) * y;
+// Two 8-bit channels of a pixel in the 32-bit lanes of a 64-bit word,
+// with room for a 16-bit coverage multiply without carrying across
+static inline uint64_t lanes(uint32_t two_channels) {
+    return (two_channels & 0xff) | ((uint64_t)(two_channels & 0xff0000) << 16);
 }
 
-static int floor(float x) {
-    return (int)x - (x < (int)x);
-}
-
-
 // Plot algorithm
-// Takes in coordinates, brightess, and color for anti-aliasing
-void plot(int x, int y, float brightness, color_t c) {
-    // Check if in bounds
-    if (x < 0 || x >= gl_get_width() || y < 0 || y >= gl_get_height()) {
+// Blend c over the pixel at x, y with coverage alpha (0..WU_ONE), two
+// channels per multiply, straight into the draw buffer
+static inline void plot(uint32_t *buffer, int x, int y, unsigned int alpha, color_t c) {
+    // Check if in bounds (nothing to do at zero coverage)
+    if (x < 0 || x >= gl_width || y < 0 || y >= gl_height || alpha == 0) {
         return;
     }
 
-    // Read the current color at x, y
-    color_t current_color = gl_read_pixel(x, y);
-    unsigned char *current_pixel = (unsigned char *)&current_color;
-    unsigned char *new_pixel = (unsigned char *)&c;
-    unsigned char blended_pixel[4];
-
-    // Blend the colors depending on brightness
-    for (int i = 0; i < 4; i++) {
-        blended_pixel[i] = (unsigned char)((1 - brightness) * current_pixel[i] + brightness * new_pixel[i]);
-    }
-    // Revert blended_color to color_t
-    color_t blended_color = *(color_t *)blended_pixel;
+    uint32_t *pixel = &buffer[y * gl_width + x];
+    uint32_t cur = *pixel;
+    uint64_t rest = WU_ONE - alpha;
+    const uint64_t mask = 0x000000ff000000ffULL;
 
-    // Draw blended color
-    gl_draw_pixel(x, y, blended_color);
+    // blue and red in one word, green and alpha in the other
+    uint64_t br = ((lanes(cur) * rest + lanes(c) * alpha) >> WU_FRAC_BITS) & mask;
+    uint64_t ga = ((lanes(cur >> 8) * rest + lanes(c >> 8) * alpha) >> WU_FRAC_BITS) & mask;
+    *pixel = (uint32_t)(br | (br >> 16) | (ga << 8) | (ga >> 8));
 }
 
-// Draw line based on Xialin Wu's line algorithm
+// Draw line based on Xialin Wu's line algorithm, in 16.16 fixed point
+// (no float: rv64im has no FPU, every float op would be a library call)
 void gl_draw_line(int x0, int y0, int x1, int y1, color_t c) {
     // Check if it's steep
     int steep = abs(y1 - y0) > abs(x1 - x0);
@@ -212,52 +355,63 @@ void gl_draw_line(int x0, int y0, int x1, int y1, color_t c) {
         y1 = temp;
     }
 
-    // Gradient calculation
+    uint32_t *buffer = fb_get_draw_buffer();
+
     int dx = x1 - x0;
     int dy = y1 - y0;
-    float gradient = dy / (float)dx;
-
-    // First endpoint
-    float xend = round(x0);
-    float yend = y0 + gradient * (xend - x0);
-    float xgap = 1.0 - fmod(x0 + 0.5, 1.0);
-    int xpxl1 = xend;
-    int ypxl1 = floor(yend);
+
+    // Everything lands in the endpoints' bounding box: the y + 1 row below
+    // intery only passes the lower endpoint with zero coverage
+    int top = dy < 0 ? y1 : y0;
     if (steep) {
-        plot(ypxl1, xpxl1, (1.0 - fmod(yend, 1.0)) * xgap, c);
-        plot(ypxl1 + 1, xpxl1, fmod(yend, 1.0) * xgap, c);
+        fb_damage(top, x0, abs(dy) + 1, dx + 1);
     } else {
-        plot(xpxl1, ypxl1, (1.0 - fmod(yend, 1.0)) * xgap, c);
-        plot(xpxl1, ypxl1 + 1, fmod(yend, 1.0) * xgap, c);
+        fb_damage(x0, top, dx + 1, abs(dy) + 1);
     }
-    float intery = yend + gradient;
 
-    // Second endpoint
-    xend = round(x1);
-    yend = y1 + gradient * (xend - x1);
-    xgap = fmod(x1 + 0.5, 1.0);
-    int xpxl2 = xend;
-    int ypxl2 = floor(yend);
+    // Endpoints: integer coordinates sit on pixel centers, so each end
+    // covers half a pixel on its own row
     if (steep) {
-        plot(ypxl2, xpxl2, (1.0 - fmod(yend, 1.0)) * xgap, c);
-        plot(ypxl2 + 1, xpxl2, fmod(yend, 1.0) * xgap, c);
+        plot(buffer, y0, x0, WU_ONE / 2, c);
+        plot(buffer, y1, x1, WU_ONE / 2, c);
     } else {
-        plot(xpxl2, ypxl2, (1.0 - fmod(yend, 1.0)) * xgap, c);
-        plot(xpxl2, ypxl2 + 1, fmod(yend, 1.0) * xgap, c);
+        plot(buffer, x0, y0, WU_ONE / 2, c);
+        plot(buffer, x1, y1, WU_ONE / 2, c);
+    }
+    if (dx == 0) {
+        return;
     }
 
-    // Draw the whole line
-    if (steep) {
-        for (int x = xpxl1 + 1; x < xpxl2; x++) {
-            plot(floor(intery), x, 1.0 - fmod(intery, 1.0), c);
-            plot(floor(intery) + 1, x, fmod(intery, 1.0), c);
-            intery += gradient;
+    // Gradient calculation: whole 16.16 steps plus a remainder carried
+    // Bresenham style, so intery stays exact instead of drifting
+    int64_t rise = (int64_t)dy << WU_FRAC_BITS;
+    int32_t gradient = rise / dx;
+    int32_t remainder = rise % dx;
+    if (remainder < 0) {
+        // floor division, so the remainder counts up for either slope
+        gradient--;
+        remainder += dx;
+    }
+
+    // Draw the whole line: coverage split between the two rows intery
+    // falls between
+    int32_t intery = ((int32_t)y0 << WU_FRAC_BITS) + gradient;
+    int32_t error = remainder;
+    for (int x = x0 + 1; x < x1; x++) {
+        int y = intery >> WU_FRAC_BITS;     // floor
+        unsigned int frac = intery & (WU_ONE - 1);
+        if (steep) {
+            plot(buffer, y, x, WU_ONE - frac, c);
+            plot(buffer, y + 1, x, frac, c);
+        } else {
+            plot(buffer, x, y, WU_ONE - frac, c);
+            plot(buffer, x, y + 1, frac, c);
         }
-    } else {
-        for (int x = xpxl1 + 1; x < xpxl2; x++) {
-            plot(x, floor(intery), 1.0 - fmod(intery, 1.0), c);
-            plot(x, floor(intery) + 1, fmod(intery, 1.0), c);
-            intery += gradient;
+        intery += gradient;
+        error += remainder;
+        if (error >= dx) {
+            error -= dx;
+            intery++;
         }
     }
 }
@@ -276,16 +430,17 @@ void gl_draw_circle(int x0, int y0, int radius, color_t c) {
     int x = radius;
     int y = 0;
     int radiusError = 1 - x;
+    fb_damage(x0 - radius, y0 - radius, 2 * radius + 1, 2 * radius + 1);
 
     while (x >= y) {
-        gl_draw_pixel(x0 + x, y0 + y, c);
-        gl_draw_pixel(x0 + y, y0 + x, c);
-        gl_draw_pixel(x0 - y, y0 + x, c);
-        gl_draw_pixel(x0 - x, y0 + y, c);
-        gl_draw_pixel(x0 - x, y0 - y, c);
-        gl_draw_pixel(x0 - y, y0 - x, c);
-        gl_draw_pixel(x0 + y, y0 - x, c);
-        gl_draw_pixel(x0 + x, y0 - y, c);
+        put_pixel(x0 + x, y0 + y, c);
+        put_pixel(x0 + y, y0 + x, c);
+        put_pixel(x0 - y, y0 + x, c);
+        put_pixel(x0 - x, y0 + y, c);
+        put_pixel(x0 - x, y0 - y, c);
+        put_pixel(x0 - y, y0 - x, c);
+        put_pixel(x0 + y, y0 - x, c);
+        put_pixel(x0 + x, y0 - y, c);
         y++;
 
         if (radiusError < 0) {
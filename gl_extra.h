@@ -0,0 +1,48 @@
+#ifndef GL_EXTRA_H
+#define GL_EXTRA_H
+
+#include "gl.h"
+
+/*
+ * Fast text, alongside gl_draw_char() and gl_draw_string() in gl.h.
+ *
+ * gl_init() expands the font once into a glyph atlas: every row of every
+ * glyph becomes a 1-bit-per-pixel mask in one word, so drawing a glyph
+ * is a shift and a store per lit pixel, with no font lookup, no per-pixel
+ * bounds check and no call per pixel. A run of characters is blitted a
+ * pixel row at a time across the whole run, and blank glyphs (spaces)
+ * cost nothing.
+ *
+ * For text that is drawn again and again, a gl_text_t holds the result
+ * of laying it out (line breaks and centering), so redrawing it is only
+ * the blit.
+ */
+
+// Draw n characters from `chars` in a row (no terminator needed)
+void gl_draw_chars(int x, int y, const char *chars, int n, color_t c);
+
+#define GL_TEXT_MAX_LINES 8
+#define GL_TEXT_MAX_CHARS 256
+
+typedef struct {
+    const char *source;     // string laid out (compare to reuse the layout)
+    int nlines;
+    struct {
+        int x, y;           // top left of the line
+        int start, len;     // span of chars[]
+    } lines[GL_TEXT_MAX_LINES];
+    char chars[GL_TEXT_MAX_CHARS];
+} gl_text_t;
+
+/*
+ * Lay out `str` in the band `width` pixels wide starting at x, y: broken
+ * every width / gl_get_char_width() characters, each line centered in the
+ * band and `line_height` pixels below the last. Text past
+ * GL_TEXT_MAX_CHARS or GL_TEXT_MAX_LINES is dropped.
+ */
+void gl_text_layout(gl_text_t *text, const char *str, int x, int y, int width, int line_height);
+
+// Draw laid-out text
+void gl_draw_text(const gl_text_t *text, color_t c);
+
+#endif
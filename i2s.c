@@ -1,11 +1,12 @@
 #include "timer.h"
 #include "gpio.h"
 #include "i2s.h"
+#include "i2s_clock.h"
 #include "stdint.h"
 #include "ccu.h"
 #include "printf.h"
 #include "malloc.h"
-#include "i2s.h"
+#include <stdbool.h>
 
 // this code works for the HiLetgo PCM5102 I2S IIS Lossless Digital Audio DAC Decoder Module Stereo DAC Digital-to-Analog Converter Voice Module 
 // Connect VIN on device to 3.3V, and GND on device to ground
@@ -37,22 +38,31 @@ void i2s_init(void)
 {
 }
 
-void i2s_setup(int frequency, int block_alignment) {
+// Bring-up state and timings (timer ticks, 24 MHz)
+static struct {
+    bool clock_ready;
+    i2s_clock_config_t clock;    // what PLL_AUDIO0 and the dividers run at now
+    unsigned long clock_ticks;   // most recent PLL lock
+    unsigned long setup_ticks;   // most recent i2s_setup/i2s_mic_setup
+    bool tx_16bit;               // i2s_tx_16bit(true) in effect
+    unsigned int saved_sr;       // sample resolution to put back after it
+} module;
+
+#define TICKS_PER_US 24
+// PLL setting brought up by i2s_clock_init (the mic's 32-bit frame at 44.1 kHz)
+#define DEFAULT_RATE 44100
+#define DEFAULT_BCLKS_PER_FRAME 64
+
+/*
+ * Program N/P/M1/M0 and lock PLL_AUDIO0, with the I2S2 module clock gated
+ * while the PLL output is not stable.
+ */
+static void pll_lock(const i2s_clock_config_t *cfg) {
+    unsigned long start = timer_get_ticks();
     volatile struct PLL_AUDIO0_CTRL *pll_audio0_ctrl = (struct PLL_AUDIO0_CTRL *)(PLL_AUDIO0_CTRL_REG); 
-//    volatile struct PLL_AUDIO0_CTRL *pll_audio1_ctrl = (struct PLL_AUDIO0_CTRL *)(PLL_AUDIO1_CTRL_REG); 
-
     volatile struct I2S_CLK *i2s_clk_reg = (struct I2S_CLK *)(I2S2_CLK_REG); 
-    // volatile struct I2S_ASRC_CLK *i2s_asrc_clk_reg = (struct I2S_ASRC_CLK *)(I2S2_ASRC_CLK_REG); 
-
-    i2s2 = (I2S *)I2S_2_BASE;
-    printf("original value of pll_audio0_ctrl: %x\n", *(uint32_t *)pll_audio0_ctrl);
-//    printf("original value of pll_audio1_ctrl: %x\n", *(uint32_t *)pll_audio1_ctrl);
-    /* we'll use the default for now 
-    // Firstly, disable the PLL_AUDIO through PLL_AUDIOx Control Register[PLL_ENABLE] in the CCU. (page 654)
-    ccu_write(0x78, ccu_read(0x78) & 0x7FFFFFFF);
-    */
 
-    // Secondly, set up the frequency of the PLL_AUDIO in the PLL_AUDIOx Control Register.
+    // Set up the frequency of the PLL_AUDIO in the PLL_AUDIOx Control Register.
     // PLL_AUDIO0(1X) = (24MHz*N/M1/M0)/P/4
     // The default frequency of PLL_AUDIO0(1X) is 24.5714 MHz (calc based on numbers below: 24 * (0b01010101 + 1) / 1 / 1 / (0b010100 + 1)  / 4)
     // default for register 0x78 is 0x48145500, or 0b 0100 1000 0001 0100 0101 0101 0000 0000
@@ -72,93 +82,94 @@ void i2s_setup(int frequency, int block_alignment) {
     // 4:2 unused        000
     // 1: PLL_INPUT_DIV2 M1 0, M1=PLL_INPUT_DIV2 + 1
     // 0: PLL_OUTPUT_DIV2 M0 0, M0=PLL_OUTPUT_DIV2 + 1
-
-    // After that, enable the I2S/PCM gating through the I2S/PCMx_CLK_REG when you checkout that the PLL_AUDIOx Control Register[LOCK] becomes to 1.
- 
-    // page 46: Configuring the Frequency of General PLLs (will configure audio0)
-    // Make sure the PLL is enabled.
-    // to enable:
-    // Step 1 Configure the N, M, and P factors of the PLL control register.
-    // (using defaults for now)
-    // Step 2 Write the PLL_ENABLE bit and the LDO_EN bit of the PLL control register to 1, write the
-    // PLL_OUTPUT_GATE bit of the PLL control register to 0.
-    pll_audio0_ctrl->PLL_EN = 1;  // enable pll audio
-    // pll_audio0_ctrl->PLL_LDO_EN = 0;  // enable pll ldo audio
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 0;  // output gate 
-
-    // Step 3 Write the LOCK_ENABLE bit of the PLL control register to 1.
-    pll_audio0_ctrl->LOCK_ENABLE = 1;
-
-    // Step 4 Wait for the status of the Lock to change to 1.
-    while (pll_audio0_ctrl->LOCK != 1) {}
-    // Step 5 Delay 20 us.
-    timer_delay_ms(20);
-
-    // pll_audio0_ctrl->LOCK_ENABLE = 0; 
-    pll_audio0_ctrl->PLL_EN = 0;  // disable pll audio
-                                  // setup frequency (using default)
-    // pll_audio0_ctrl->PLL_N = 254;
-    // pll_audio0_ctrl->PLL_P = 63;
-    pll_audio0_ctrl->PLL_N = 244;
-    pll_audio0_ctrl->PLL_P = 63;
-    pll_audio0_ctrl->LOCK_ENABLE = 1; 
-    while (pll_audio0_ctrl->LOCK != 1) {}
-    // delay 20us
-    timer_delay_ms(20);
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 1;
-    pll_audio0_ctrl->PLL_EN = 1;
-
-    printf("audio0 locked! new value: %x\n", *(uint32_t *)pll_audio0_ctrl);
-
-    // Enabling the PLL Follow the steps below to enable the PLL:
-    // Step 1 Configure the N, M, and P factors of the PLL control register.
-    // (using defaults)
+    // The factors come from i2s_clock_config() (see i2s_clock.h).
+    i2s_clk_reg->I2S_CLK_GATING = 0;
+
+    // page 46: Configuring the Frequency of General PLLs
+    // Step 1 Configure the N, M, and P factors of the PLL control register
+    // (with the PLL disabled).
+    pll_audio0_ctrl->PLL_EN = 0;
+    pll_audio0_ctrl->LOCK_ENABLE = 0;
+    pll_audio0_ctrl->PLL_N = cfg->pll_n;
+    pll_audio0_ctrl->PLL_P = cfg->pll_p;
+    pll_audio0_ctrl->PLL_INPUT_DIV2 = cfg->input_div2;
+    pll_audio0_ctrl->PLL_OUTPUT_DIV2 = cfg->output_div2;
     // Step 2 Write the PLL_ENABLE bit and the LDO_EN bit of the PLL control register to 1, write the PLL_OUTPUT_GATE bit of the PLL control register to 0.
     pll_audio0_ctrl->PLL_EN = 1; 
     pll_audio0_ctrl->PLL_LDO_EN = 1; 
     pll_audio0_ctrl->PLL_OUTPUT_GATE = 0;
-
     // Step 3 Write the LOCK_ENABLE bit of the PLL control register to 1.
     pll_audio0_ctrl->LOCK_ENABLE = 1; 
     // Step 4 Wait for the status of the Lock to change to 1.
     while (pll_audio0_ctrl->LOCK != 1) {}
     // Step 5 Delay 20 us.
-    timer_delay_ms(20);
+    timer_delay_us(20);
     // Step 6 Write the PLL_OUTPUT_GATE bit of the PLL control register to 1 and then the PLL will be available.
     pll_audio0_ctrl->PLL_OUTPUT_GATE = 1;
-    printf("audio0 locked again. new value: %x\n", *(uint32_t *)pll_audio0_ctrl);
 
-     
+    // After that, enable the I2S/PCM gating through the I2S/PCMx_CLK_REG when you checkout that the PLL_AUDIOx Control Register[LOCK] becomes to 1.
     i2s_clk_reg->I2S_CLK_GATING = 1;
     i2s_clk_reg->CLK_SRC_SEL = 0; // AUDIO(1X)
-    printf("i2s2_clk_reg: %x\n", *(uint32_t *)i2s_clk_reg);
+
+    module.clock = *cfg;
+    module.clock_ticks = timer_get_ticks() - start;
+    printf("i2s: audio clock %d Hz (%d ppm) locked in %ld us (pll_audio0 %x)\n", cfg->rate, (int)cfg->error_ppm,
+           module.clock_ticks / TICKS_PER_US, *(uint32_t *)pll_audio0_ctrl);
+}
+
+/*
+ * Lock PLL_AUDIO0 and ungate the I2S2 clock and bus. Done once; every
+ * later setup reuses the locked PLL unless its rate needs a different one.
+ */
+void i2s_clock_init(void) {
+    if (module.clock_ready) {
+        return;
+    }
+    i2s_clock_config_t cfg;
+    i2s_clock_config(DEFAULT_RATE, DEFAULT_BCLKS_PER_FRAME, &cfg);
+    pll_lock(&cfg);
 
     //  At last, reset and enable the I2S/PCM bus gating by setting I2S/PCM_BGR_REG.
     volatile struct I2S_PCM_BGR *i2s_pcm_bgr = (struct I2S_PCM_BGR *)(I2S_PCM_BGR_REG); 
-    printf("pcm_bgr before: %x\n", *(uint32_t *)i2s_pcm_bgr);
     i2s_pcm_bgr->I2S2_RST = 1;
     i2s_pcm_bgr->I2S2_GATING = 1;
-    printf("pcm_bgr after: %x\n", *(uint32_t *)i2s_pcm_bgr);
-    // MAYBE WE HAVE TO SET BACK TO 0??
-    // i2s_pcm_bgr->I2S2_RST = 0;
+
+    i2s2 = (I2S *)I2S_2_BASE;
+    module.clock_ready = true;
+}
+
+// Stop the controller, clear the FIFOs and set the frame clock. A rate that
+// shares the locked PLL setting only changes the dividers, so this takes
+// microseconds; otherwise the PLL relocks. In the table the 44.1 kHz family
+// shares one setting (22.58 MHz) and the 48 kHz family another (24.58 MHz),
+// except 32000 and 192000 Hz with 64-BCLK frames: they would need a divide
+// ratio of 3 or 1/2 from 24.58 MHz, so they use 16.38 and 49.15 MHz
+static void controller_setup(int frequency, int bclks_per_frame) {
+    unsigned long start = timer_get_ticks();
+    i2s_clock_init();
+
+    i2s_clock_config_t cfg;
+    if (!i2s_clock_config(frequency, bclks_per_frame, &cfg)) {
+        printf("i2s: no clock setting for %d Hz, keeping %d Hz\n", frequency, module.clock.rate);
+        cfg = module.clock;
+    }
 
     // Firstly, initialize the I2S/PCM. You should close the Globe Enable 
     // bit (I2S/PCM_CTL[0]), Transmitter Block Enable bit (I2S/PCM_CTL[2]), 
     // and Receiver Block Enable bit (I2S/PCM_CTL[1]) by writing 0. 
-    printf("i2s2->ctl before: %x\n", *(uint32_t *)&(i2s2->regs.ctl));
-    // for (uint32_t i = 0; i < 0xa0; i+=4) {
-    //     printf("offset: %x, value:%x\n", i, *(uint32_t *)(0x02032000UL + i));
-    //     // printf("offset: %x, value:%x\n", i, *(uint32_t *)(0x02001000UL + i));
-    // }
     i2s2->regs.ctl.GEN = 0;
     i2s2->regs.ctl.RXEN = 0;
     i2s2->regs.ctl.TXEN = 0;
-    printf("is2->ctl after: %x\n", *(uint32_t *)&(i2s2->regs.ctl));
+    if (!i2s_clock_same_pll(&cfg, &module.clock)) {
+        pll_lock(&cfg);
+    }
+    module.clock = cfg;
     // After that, clear the TX/RX FIFO by writing 0 to the
     // bit[25:24] of I2S/PCM_FCTL.
     i2s2->regs.fctl.FTX = 0;
     i2s2->regs.fctl.FRX = 0;
-    printf("is2->fctl after: %x\n", *(uint32_t *)&(i2s2->regs.fctl));
+    i2s2->regs.fctl.TXIM = 0; // left-justified 32-bit words until i2s_tx_16bit()
+    module.tx_16bit = false;  // the enable that follows sets the resolution afresh
     // At last, you can clear the TX FIFO and RX FIFO counter by writing 0 to
     // I2S/PCM_TXCNT and I2S/PCM_RXCNT.
     i2s2->regs.txcnt = 0; 
@@ -175,27 +186,27 @@ void i2s_setup(int frequency, int block_alignment) {
     i2s2->regs.ctl.MODE_SEL = 1; // left justified (for PCM5102A chip)
     i2s2->regs.ctl.OUT_MUTE = 0; 
     
-    printf("is2->fmt0 before: %x\n", *(uint32_t *)&(i2s2->regs.fmt0));
-    // i2s2->regs.fmt0.SR = 0x3; // 16-bit sample resolution
-    // i2s2->regs.fmt0.SW = 0x3; // 16-bit slot width (?) 
-    //i2s2->regs.fmt0.LRCK_PERIOD = 31; 
-    int block_div_frac = frequency / 44100 * 8 / block_alignment; 
-    switch (block_div_frac) {
-       case 1:
-           i2s2->regs.clkd.BCLKDIV = 0x1;
-           break;
-       case 2:
-           i2s2->regs.clkd.BCLKDIV = 0x2;
-           break;
-       case 4:
-           i2s2->regs.clkd.BCLKDIV = 0x3;
-           break;
-       default:
-           i2s2->regs.clkd.BCLKDIV = 0x2;
-    }
-    
-    printf("is2->fmt0 after: %x\n", *(uint32_t *)&(i2s2->regs.fmt0));
-    printf("finished.\n");
+    i2s2->regs.clkd.BCLKDIV = cfg.bclkdiv;
+    i2s2->regs.clkd.MCLKDIV = cfg.mclkdiv;
+    module.setup_ticks = timer_get_ticks() - start;
+}
+
+void i2s_setup(int frequency, int block_alignment) {
+    // 16 BCLKs per byte of block alignment, as the BCLKDIV choices here
+    // always assumed (i2s_enable's mono frame is 2 x 16 BCLKs)
+    controller_setup(frequency, 16 * block_alignment);
+}
+
+unsigned int i2s_clock_init_us(void) {
+    return module.clock_ticks / TICKS_PER_US;
+}
+
+unsigned int i2s_setup_us(void) {
+    return module.setup_ticks / TICKS_PER_US;
+}
+
+int i2s_rate_error_ppm(void) {
+    return module.clock.error_ppm;
 }
 
 
@@ -212,7 +223,7 @@ void i2s_enable(CHANNEL_TYPE channel_type)
     // gpio_set_function( MCLK,  GPIO_FN_ALT3 );  
 
     // printf("mclko before: %x\n", *(uint32_t *)&(i2s2->regs.clkd));
-    i2s2->regs.clkd.MCLKDIV = 0x1;
+    // (MCLKDIV is set with BCLKDIV by the clock solver in i2s_setup)
     // i2s2->regs.clkd.MCLKO_EN = 1;
     i2s2->regs.ctl.DOUT0_EN = 1;
     // i2s2->regs.ctl.DOUT1_EN = 0;
@@ -222,6 +233,9 @@ void i2s_enable(CHANNEL_TYPE channel_type)
    
     // working (non-stereo):
     if (channel_type == MONO) {
+        // set explicitly: a mic or duplex setup before this leaves 32-bit values
+        i2s2->regs.fmt0.SW = 0x3; // 16-bit slot width
+        i2s2->regs.fmt0.SR = 0x3; // 16-bit sample resolution
         i2s2->regs.fmt0.LRCK_PERIOD = 15; 
         i2s2->regs.chcfg.TX_SLOT_NUM = 0x0; 
         i2s2->regs.txxchsel[0].TXx_CHEN = 0x3;
@@ -310,6 +324,31 @@ unsigned i2s_get_status(void) {
     return status;
 }
 
+void i2s_set_resolution(int bits) {
+    i2s2->regs.fmt0.SR = bits / 4 - 1; // 3: 16-bit, 5: 24-bit, 7: 32-bit
+}
+
+void i2s_tx_16bit(bool enable) {
+    if (enable == module.tx_16bit) {
+        return;
+    }
+    // TXIM=1: the FIFO takes each sample from the low half of the write,
+    // so a 16-bit DMA store is one whole sample, at 16-bit resolution.
+    // Leaving puts back the resolution the setup chose.
+    if (enable) {
+        module.saved_sr = i2s2->regs.fmt0.SR;
+        i2s2->regs.fmt0.SR = 0x3; // 16-bit sample resolution
+    } else {
+        i2s2->regs.fmt0.SR = module.saved_sr;
+    }
+    i2s2->regs.fctl.TXIM = enable;
+    module.tx_16bit = enable;
+}
+
+unsigned i2s_tx_space(void) {
+    return i2s2->regs.fsta.TXE_CNT;
+}
+
 void i2s_write_stereo(uint16_t left, uint16_t right) {
     i2s2->regs.txfifo = left << 16;
     i2s2->regs.txfifo = right << 16;
@@ -320,164 +359,7 @@ void i2s_write_mono(uint16_t value) {
 }
 
 void i2s_mic_setup(int frequency) {
-    volatile struct PLL_AUDIO0_CTRL *pll_audio0_ctrl = (struct PLL_AUDIO0_CTRL *)(PLL_AUDIO0_CTRL_REG); 
-//    volatile struct PLL_AUDIO0_CTRL *pll_audio1_ctrl = (struct PLL_AUDIO0_CTRL *)(PLL_AUDIO1_CTRL_REG); 
-
-    volatile struct I2S_CLK *i2s_clk_reg = (struct I2S_CLK *)(I2S2_CLK_REG); 
-    // volatile struct I2S_ASRC_CLK *i2s_asrc_clk_reg = (struct I2S_ASRC_CLK *)(I2S2_ASRC_CLK_REG); 
-
-    i2s2 = (I2S *)I2S_2_BASE;
-    printf("original value of pll_audio0_ctrl: %x\n", *(uint32_t *)pll_audio0_ctrl);
-//    printf("original value of pll_audio1_ctrl: %x\n", *(uint32_t *)pll_audio1_ctrl);
-    /* we'll use the default for now 
-    // Firstly, disable the PLL_AUDIO through PLL_AUDIOx Control Register[PLL_ENABLE] in the CCU. (page 654)
-    ccu_write(0x78, ccu_read(0x78) & 0x7FFFFFFF);
-    */
-
-    // Secondly, set up the frequency of the PLL_AUDIO in the PLL_AUDIOx Control Register.
-    // PLL_AUDIO0(1X) = (24MHz*N/M1/M0)/P/4
-    // The default frequency of PLL_AUDIO0(1X) is 24.5714 MHz (calc based on numbers below: 24 * (0b01010101 + 1) / 1 / 1 / (0b010100 + 1)  / 4)
-    // default for register 0x78 is 0x48145500, or 0b 0100 1000 0001 0100 0101 0101 0000 0000
-    // bits:      default:
-    // 31: PLL_EN       0
-    // 30: PLL_LDO_EN   1
-    // 29: LOCK_ENABLE  0
-    // 28: LOCK         0
-    // 27: PLL_OUTPUT_GATE 1
-    // 26:25 unused     00
-    // 24: PLL_SDM_EN   0
-    // 23:22 unused     00
-    // 21:16 PLL_P      01 0100, P= PLL_POST_DIV_P +1
-    // 15:8 PLL_N       0101 0101, N= PLL_N +1
-    // 7:6 PLL_UNLOCK_MDSEL 00
-    // 5: PLL_LOCK_MDSEL 0
-    // 4:2 unused        000
-    // 1: PLL_INPUT_DIV2 M1 0, M1=PLL_INPUT_DIV2 + 1
-    // 0: PLL_OUTPUT_DIV2 M0 0, M0=PLL_OUTPUT_DIV2 + 1
-
-    // After that, enable the I2S/PCM gating through the I2S/PCMx_CLK_REG when you checkout that the PLL_AUDIOx Control Register[LOCK] becomes to 1.
- 
-    // page 46: Configuring the Frequency of General PLLs (will configure audio0)
-    // Make sure the PLL is enabled.
-    // to enable:
-    // Step 1 Configure the N, M, and P factors of the PLL control register.
-    // (using defaults for now)
-    // Step 2 Write the PLL_ENABLE bit and the LDO_EN bit of the PLL control register to 1, write the
-    // PLL_OUTPUT_GATE bit of the PLL control register to 0.
-    pll_audio0_ctrl->PLL_EN = 1;  // enable pll audio
-    // pll_audio0_ctrl->PLL_LDO_EN = 0;  // enable pll ldo audio
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 0;  // output gate 
-
-    // Step 3 Write the LOCK_ENABLE bit of the PLL control register to 1.
-    pll_audio0_ctrl->LOCK_ENABLE = 1;
-
-    // Step 4 Wait for the status of the Lock to change to 1.
-    while (pll_audio0_ctrl->LOCK != 1) {}
-    // Step 5 Delay 20 us.
-    timer_delay_ms(20);
-
-    // pll_audio0_ctrl->LOCK_ENABLE = 0; 
-    pll_audio0_ctrl->PLL_EN = 0;  // disable pll audio
-                                  // setup frequency (using default)
-    // pll_audio0_ctrl->PLL_N = 254;
-    // pll_audio0_ctrl->PLL_P = 63;
-    pll_audio0_ctrl->PLL_N = 244;
-    pll_audio0_ctrl->PLL_P = 63;
-    pll_audio0_ctrl->LOCK_ENABLE = 1; 
-    while (pll_audio0_ctrl->LOCK != 1) {}
-    // delay 20us
-    timer_delay_ms(20);
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 1;
-    pll_audio0_ctrl->PLL_EN = 1;
-
-    printf("audio0 locked! new value: %x\n", *(uint32_t *)pll_audio0_ctrl);
-
-    // Enabling the PLL Follow the steps below to enable the PLL:
-    // Step 1 Configure the N, M, and P factors of the PLL control register.
-    // (using defaults)
-    // Step 2 Write the PLL_ENABLE bit and the LDO_EN bit of the PLL control register to 1, write the PLL_OUTPUT_GATE bit of the PLL control register to 0.
-    pll_audio0_ctrl->PLL_EN = 1; 
-    pll_audio0_ctrl->PLL_LDO_EN = 1; 
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 0;
-
-    // Step 3 Write the LOCK_ENABLE bit of the PLL control register to 1.
-    pll_audio0_ctrl->LOCK_ENABLE = 1; 
-    // Step 4 Wait for the status of the Lock to change to 1.
-    while (pll_audio0_ctrl->LOCK != 1) {}
-    // Step 5 Delay 20 us.
-    timer_delay_ms(20);
-    // Step 6 Write the PLL_OUTPUT_GATE bit of the PLL control register to 1 and then the PLL will be available.
-    pll_audio0_ctrl->PLL_OUTPUT_GATE = 1;
-    printf("audio0 locked again. new value: %x\n", *(uint32_t *)pll_audio0_ctrl);
-
-     
-    i2s_clk_reg->I2S_CLK_GATING = 1;
-    i2s_clk_reg->CLK_SRC_SEL = 0; // AUDIO(1X)
-    printf("i2s2_clk_reg: %x\n", *(uint32_t *)i2s_clk_reg);
-
-    //  At last, reset and enable the I2S/PCM bus gating by setting I2S/PCM_BGR_REG.
-    volatile struct I2S_PCM_BGR *i2s_pcm_bgr = (struct I2S_PCM_BGR *)(I2S_PCM_BGR_REG); 
-    printf("pcm_bgr before: %x\n", *(uint32_t *)i2s_pcm_bgr);
-    i2s_pcm_bgr->I2S2_RST = 1;
-    i2s_pcm_bgr->I2S2_GATING = 1;
-    printf("pcm_bgr after: %x\n", *(uint32_t *)i2s_pcm_bgr);
-    // MAYBE WE HAVE TO SET BACK TO 0??
-    // i2s_pcm_bgr->I2S2_RST = 0;
-
-    // Firstly, initialize the I2S/PCM. You should close the Globe Enable 
-    // bit (I2S/PCM_CTL[0]), Transmitter Block Enable bit (I2S/PCM_CTL[2]), 
-    // and Receiver Block Enable bit (I2S/PCM_CTL[1]) by writing 0. 
-    printf("i2s2->ctl before: %x\n", *(uint32_t *)&(i2s2->regs.ctl));
-    // for (uint32_t i = 0; i < 0xa0; i+=4) {
-    //     printf("offset: %x, value:%x\n", i, *(uint32_t *)(0x02032000UL + i));
-    //     // printf("offset: %x, value:%x\n", i, *(uint32_t *)(0x02001000UL + i));
-    // }
-    i2s2->regs.ctl.GEN = 0;
-    i2s2->regs.ctl.RXEN = 0;
-    i2s2->regs.ctl.TXEN = 0;
-    printf("is2->ctl after: %x\n", *(uint32_t *)&(i2s2->regs.ctl));
-    // After that, clear the TX/RX FIFO by writing 0 to the
-    // bit[25:24] of I2S/PCM_FCTL.
-    i2s2->regs.fctl.FTX = 0;
-    i2s2->regs.fctl.FRX = 0;
-    printf("is2->fctl after: %x\n", *(uint32_t *)&(i2s2->regs.fctl));
-    // At last, you can clear the TX FIFO and RX FIFO counter by writing 0 to
-    // I2S/PCM_TXCNT and I2S/PCM_RXCNT.
-    i2s2->regs.txcnt = 0; 
-    i2s2->regs.rxcnt = 0; 
-
-    // First, you can set up the I2S/PCM of master and slave. The configuration 
-    // can be referred to the protocol of I2S/PCM. 
-    i2s2->regs.ctl.BCLK_OUT = 1;
-    i2s2->regs.ctl.LRCK_OUT = 1;
-
-    // Then, you can set up the translation mode, the sample resolution, 
-    // the wide of the slot, the channel slot number, and the trigger level, and so on. 
-    // The setup of the register can be found in the specification.
-    i2s2->regs.ctl.MODE_SEL = 1; // left justified (for PCM5102A chip)
-    i2s2->regs.ctl.OUT_MUTE = 0; 
-    
-    printf("is2->fmt0 before: %x\n", *(uint32_t *)&(i2s2->regs.fmt0));
-    // i2s2->regs.fmt0.SR = 0x3; // 16-bit sample resolution
-    // i2s2->regs.fmt0.SW = 0x3; // 16-bit slot width (?) 
-    //i2s2->regs.fmt0.LRCK_PERIOD = 31; 
-    int block_div_frac = frequency / 44100 * 8 / 4; // 4 was block_alignment
-    switch (block_div_frac) {
-       case 1:
-           i2s2->regs.clkd.BCLKDIV = 0x1;
-           break;
-       case 2:
-           i2s2->regs.clkd.BCLKDIV = 0x2;
-           break;
-       case 4:
-           i2s2->regs.clkd.BCLKDIV = 0x3;
-           break;
-       default:
-           i2s2->regs.clkd.BCLKDIV = 0x2;
-    }
-    
-    printf("is2->fmt0 after: %x\n", *(uint32_t *)&(i2s2->regs.fmt0));
-    printf("finished.\n");
+    controller_setup(frequency, 64); // the mic's frame: 2 x 32-bit slots
 }
 
 
@@ -489,7 +371,7 @@ void i2s_mic_enable()
     // gpio_set_function( MCLK,  GPIO_FN_ALT3 );  
 
     // printf("mclko before: %x\n", *(uint32_t *)&(i2s2->regs.clkd));
-    i2s2->regs.clkd.MCLKDIV = 0x2;
+    // (MCLKDIV is set with BCLKDIV by the clock solver in i2s_mic_setup)
     // i2s2->regs.clkd.MCLKO_EN = 1;
     // i2s2->regs.ctl.DOUT0_EN = 1;
     // printf("mclko after: %x\n", *(uint32_t *)&(i2s2->regs.clkd));
@@ -546,3 +428,29 @@ void i2s_mic_start() {
     i2s2->regs.ctl.GEN = 1;
     i2s2->regs.txcnt = 0;
 }
+
+void i2s_duplex_enable(void)
+{
+    // capture side sets up the shared 32-bit frame and clock dividers
+    i2s_mic_enable();
+
+    gpio_set_function( DOUT0, GPIO_FN_ALT3 );  
+    i2s2->regs.ctl.DOUT0_EN = 1;
+
+    // same mono slot layout as i2s_enable(MONO), on the 32-bit frame
+    i2s2->regs.chcfg.TX_SLOT_NUM = 0x0; 
+    i2s2->regs.txxchsel[0].TXx_CHEN = 0x3;
+    i2s2->regs.txxchsel[0].TXx_CHSEL = 0x1;
+    i2s2->regs.txxchsel[0].TXx_OFFSET = 0x1;
+
+    i2s2->regs.fctl.FTX = 0;
+    i2s2->regs.txcnt = 0; 
+}
+
+void i2s_duplex_start(void) {
+    i2s2->regs.ctl.TXEN = 1;
+    i2s2->regs.ctl.RXEN = 1;
+    i2s2->regs.ctl.GEN = 1;
+    i2s2->regs.txcnt = 0;
+    i2s2->regs.rxcnt = 0;
+}
@@ -2,6 +2,7 @@
 #define I2S_H
 
 #include<stdint.h>
+#include <stdbool.h>
 
 /*
  * Hardware abstractions for pulse width modulation (I2S) of
@@ -396,11 +397,27 @@ void i2s_init(void);
 void i2s_set_clock(int frequency);
 
 /*
- * Setup I2S
+ * Bring up the audio clock tree (PLL_AUDIO0 lock, I2S2 clock and bus
+ * gating). Only the first call does any work.
+ */
+void i2s_clock_init(void);
+
+/*
+ * Setup I2S for playback or capture at `frequency` Hz. The PLL and
+ * dividers come from the solver in i2s_clock.h; when the new rate shares
+ * the locked PLL setting (the same rate family), only the dividers change
+ * and switching between capture, playback and duplex takes microseconds.
  */
 void i2s_setup(int frequency, int block_alignment);
 void i2s_mic_setup(int frequency);
 
+// Measured time of the clock bring-up and of the most recent setup
+unsigned int i2s_clock_init_us(void);
+unsigned int i2s_setup_us(void);
+
+// Achieved frame rate vs the requested one for the current setup, ppm
+int i2s_rate_error_ppm(void);
+
 /*
  * Enable or disable I2S.
  *
@@ -434,6 +451,34 @@ void i2s_write_mono(uint16_t value);
  */
 unsigned int i2s_get_status(void);
 
+/*
+ * Sample resolution (16, 20, 24, 28 or 32 bits) within the current slot
+ * width; samples are taken from the top of each left-justified word.
+ */
+void i2s_set_resolution(int bits);
+
+/*
+ * Switch the TX FIFO between 32-bit left-justified words (the default,
+ * i2s_write_mono/i2s_write_stereo and 32-bit DMA) and packed 16-bit
+ * samples written to the low half (16-bit DMA straight from int16 data).
+ * Enabling also sets 16-bit sample resolution; disabling restores the
+ * resolution from before.
+ */
+void i2s_tx_16bit(bool enable);
+
+/*
+ * Free space in the TX FIFO, in 32-bit words. One read is enough to know
+ * how many i2s_write_mono/i2s_write_stereo words can go in back to back.
+ */
+unsigned int i2s_tx_space(void);
+
 void i2s_mic_start();
 
+/*
+ * Full duplex: capture and playback share the mic's 32-bit frame format
+ * and clocks, so both FIFOs run at once.
+ */
+void i2s_duplex_enable(void);
+void i2s_duplex_start(void);
+
 #endif
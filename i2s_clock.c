@@ -0,0 +1,130 @@
+/* File: i2s_clock.c
+ * -----------------
+ *  PLL_AUDIO0 and I2S divider solver (pure arithmetic, runs on host and target)
+ */
+#include "i2s_clock.h"
+
+// I2S_CLKD divide ratios; the register code is the index + 1
+static const uint8_t clkd_ratios[] = {1, 2, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 176, 192};
+#define NUM_CLKD_RATIOS (int)(sizeof(clkd_ratios) / sizeof(clkd_ratios[0]))
+
+// PLL outputs the solver will use, and the one it prefers on a tie
+#define PLL_MIN_HZ 8000000
+#define PLL_MAX_HZ 50000000
+#define PLL_PREFERRED_HZ 24576000
+
+#ifndef I2S_CLOCK_NO_TABLE
+#include "i2s_clock_table.h"
+#endif
+
+uint32_t i2s_clock_pll_hz(const i2s_clock_config_t *cfg) {
+    uint64_t num = (uint64_t)I2S_CLOCK_OSC_HZ * (cfg->pll_n + 1);
+    uint64_t den = (uint64_t)(cfg->input_div2 + 1) * (cfg->output_div2 + 1) * (cfg->pll_p + 1) * 4;
+    return (uint32_t)((num + den / 2) / den);
+}
+
+uint64_t i2s_clock_rate_mhz(const i2s_clock_config_t *cfg) {
+    uint64_t num = (uint64_t)I2S_CLOCK_OSC_HZ * 1000 * (cfg->pll_n + 1);
+    uint64_t den = (uint64_t)(cfg->input_div2 + 1) * (cfg->output_div2 + 1) * (cfg->pll_p + 1) * 4 *
+                   I2S_CLOCK_MODULE_DIV * clkd_ratios[cfg->bclkdiv - 1] * cfg->bclks_per_frame;
+    return (num + den / 2) / den;
+}
+
+bool i2s_clock_same_pll(const i2s_clock_config_t *a, const i2s_clock_config_t *b) {
+    return a->pll_n == b->pll_n && a->pll_p == b->pll_p &&
+           a->input_div2 == b->input_div2 && a->output_div2 == b->output_div2;
+}
+
+static uint64_t abs_diff(uint64_t a, uint64_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// Best N/P/M1/M0 for one BCLK ratio; returns the error in millihertz
+static uint64_t solve_pll(int rate, int bclks_per_frame, int ratio_index, i2s_clock_config_t *cfg) {
+    uint64_t target_mhz = (uint64_t)rate * 1000;
+    uint64_t best = UINT64_MAX;
+    i2s_clock_config_t trial = *cfg;
+    trial.bclkdiv = ratio_index + 1;
+
+    for (int m = 0; m < 4; m++) {
+        trial.input_div2 = m >> 1;
+        trial.output_div2 = m & 1;
+        int mdiv = (trial.input_div2 + 1) * (trial.output_div2 + 1);
+        for (int p = 1; p <= 64; p++) {
+            // N that puts the frame rate closest to the target for this P and M
+            uint64_t den = (uint64_t)I2S_CLOCK_OSC_HZ;
+            uint64_t num = (uint64_t)rate * bclks_per_frame * clkd_ratios[ratio_index] * I2S_CLOCK_MODULE_DIV *
+                           4 * p * mdiv;
+            uint64_t n = (num + den / 2) / den;
+            if (n < 1 || n > 256) {
+                continue;
+            }
+            trial.pll_n = n - 1;
+            trial.pll_p = p - 1;
+            uint32_t pll = i2s_clock_pll_hz(&trial);
+            if (pll < PLL_MIN_HZ || pll > PLL_MAX_HZ) {
+                continue;
+            }
+            uint64_t err = abs_diff(i2s_clock_rate_mhz(&trial), target_mhz);
+            if (err < best) {
+                best = err;
+                *cfg = trial;
+            }
+        }
+    }
+    return best;
+}
+
+// MCLKDIV code that brings MCLK closest to I2S_CLOCK_MCLK_FS * rate
+static uint8_t pick_mclkdiv(const i2s_clock_config_t *cfg) {
+    uint64_t module_hz = i2s_clock_pll_hz(cfg) / I2S_CLOCK_MODULE_DIV;
+    uint64_t want = (uint64_t)cfg->rate * I2S_CLOCK_MCLK_FS;
+    int best = 0;
+    for (int i = 1; i < NUM_CLKD_RATIOS; i++) {
+        if (abs_diff(module_hz / clkd_ratios[i], want) < abs_diff(module_hz / clkd_ratios[best], want)) {
+            best = i;
+        }
+    }
+    return best + 1;
+}
+
+bool i2s_clock_solve(int rate, int bclks_per_frame, i2s_clock_config_t *cfg) {
+    uint64_t best_err = UINT64_MAX;
+    uint32_t best_pref = UINT32_MAX;
+    i2s_clock_config_t best = {0};
+
+    for (int r = 0; r < NUM_CLKD_RATIOS; r++) {
+        i2s_clock_config_t trial = {.rate = rate, .bclks_per_frame = bclks_per_frame};
+        uint64_t err = solve_pll(rate, bclks_per_frame, r, &trial);
+        if (err == UINT64_MAX) {
+            continue;
+        }
+        // lowest error wins; on a tie, the PLL nearest the usual audio clock
+        uint32_t pref = (uint32_t)abs_diff(i2s_clock_pll_hz(&trial), PLL_PREFERRED_HZ);
+        if (err < best_err || (err == best_err && pref < best_pref)) {
+            best_err = err;
+            best_pref = pref;
+            best = trial;
+        }
+    }
+    if (best_err == UINT64_MAX) {
+        return false;
+    }
+    best.mclkdiv = pick_mclkdiv(&best);
+    int64_t diff = (int64_t)i2s_clock_rate_mhz(&best) - (int64_t)rate * 1000;
+    best.error_ppm = (int32_t)(diff * 1000 / rate);   // mHz * 1000 / Hz = ppm
+    *cfg = best;
+    return true;
+}
+
+bool i2s_clock_config(int rate, int bclks_per_frame, i2s_clock_config_t *cfg) {
+#ifndef I2S_CLOCK_NO_TABLE
+    for (int i = 0; i < (int)(sizeof(i2s_clock_table) / sizeof(i2s_clock_table[0])); i++) {
+        if (i2s_clock_table[i].rate == rate && i2s_clock_table[i].bclks_per_frame == bclks_per_frame) {
+            *cfg = i2s_clock_table[i];
+            return true;
+        }
+    }
+#endif
+    return i2s_clock_solve(rate, bclks_per_frame, cfg);
+}
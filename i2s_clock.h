@@ -0,0 +1,65 @@
+#ifndef I2S_CLOCK_H
+#define I2S_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Sample-rate solver for the I2S2 clock tree.
+ *
+ * PLL_AUDIO0(1X) = (24MHz * N / M1 / M0) / P / 4, as documented for the
+ * PLL_AUDIO0 control register. The I2S2 module clock is taken from it,
+ * BCLK = module clock / BCLKDIV, and a frame is `bclks_per_frame` BCLKs
+ * (LRCK_PERIOD + 1 per half frame). For each rate the solver picks
+ * N/P/M1/M0 and the BCLKDIV/MCLKDIV codes that land closest to it.
+ *
+ * The common rates are solved ahead of time into i2s_clock_table.h by
+ * tools/i2s_clock_gen, which also checks every entry against the formula
+ * above on the host. Other rates are solved at run time.
+ */
+
+#define I2S_CLOCK_OSC_HZ 24000000
+// Measured: with the working 44.1 kHz setup the frame clock comes out at
+// PLL_AUDIO0(1X) / (4 * BCLKDIV * bclks_per_frame)
+#define I2S_CLOCK_MODULE_DIV 4
+// MCLK the solver aims for, in multiples of the frame rate
+#define I2S_CLOCK_MCLK_FS 256
+
+typedef struct {
+    int rate;                   // requested frame rate, Hz
+    uint8_t bclks_per_frame;
+    // PLL_AUDIO0 register fields (factor - 1)
+    uint8_t pll_n;
+    uint8_t pll_p;
+    uint8_t input_div2;         // M1 - 1
+    uint8_t output_div2;        // M0 - 1
+    // I2S_CLKD codes
+    uint8_t bclkdiv;
+    uint8_t mclkdiv;
+    int32_t error_ppm;          // achieved rate vs requested
+} i2s_clock_config_t;
+
+/*
+ * Search the full N/P/M1/M0 and BCLKDIV space for `rate`.
+ *
+ * @return false if no divider setting reaches the rate
+ */
+bool i2s_clock_solve(int rate, int bclks_per_frame, i2s_clock_config_t *cfg);
+
+/*
+ * Precomputed entry for `rate`, or run the solver if there is none.
+ *
+ * @return false if the rate cannot be reached
+ */
+bool i2s_clock_config(int rate, int bclks_per_frame, i2s_clock_config_t *cfg);
+
+// PLL_AUDIO0(1X) output for a configuration, Hz
+uint32_t i2s_clock_pll_hz(const i2s_clock_config_t *cfg);
+
+// Frame rate a configuration actually produces, in millihertz
+uint64_t i2s_clock_rate_mhz(const i2s_clock_config_t *cfg);
+
+// True if both configurations run the PLL the same way (no relock needed)
+bool i2s_clock_same_pll(const i2s_clock_config_t *a, const i2s_clock_config_t *b);
+
+#endif
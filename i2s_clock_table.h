@@ -0,0 +1,21 @@
+// Generated by tools/i2s_clock_gen -- do not edit
+static const i2s_clock_config_t i2s_clock_table[] = {
+    {.rate = 8000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 8, .mclkdiv = 3, .error_ppm = 37},
+    {.rate = 16000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 6, .mclkdiv = 2, .error_ppm = 37},
+    {.rate = 22050, .bclks_per_frame = 32, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 5, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 32000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 4, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 44100, .bclks_per_frame = 32, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 3, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 48000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 3, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 88200, .bclks_per_frame = 32, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 2, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 96000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 2, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 192000, .bclks_per_frame = 32, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 1, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 8000, .bclks_per_frame = 64, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 6, .mclkdiv = 3, .error_ppm = 37},
+    {.rate = 16000, .bclks_per_frame = 64, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 4, .mclkdiv = 2, .error_ppm = 37},
+    {.rate = 22050, .bclks_per_frame = 64, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 3, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 32000, .bclks_per_frame = 64, .pll_n = 70, .pll_p = 25, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 2, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 44100, .bclks_per_frame = 64, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 2, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 48000, .bclks_per_frame = 64, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 2, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 88200, .bclks_per_frame = 64, .pll_n = 142, .pll_p = 37, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 1, .mclkdiv = 1, .error_ppm = -11},
+    {.rate = 96000, .bclks_per_frame = 64, .pll_n = 212, .pll_p = 51, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 1, .mclkdiv = 1, .error_ppm = 37},
+    {.rate = 192000, .bclks_per_frame = 64, .pll_n = 212, .pll_p = 25, .input_div2 = 0, .output_div2 = 0, .bclkdiv = 1, .mclkdiv = 1, .error_ppm = 37},
+};
@@ -3,55 +3,118 @@
  *  my keyboard implementation (modified for extension) (modified for test 23)
  */
 #include "keyboard.h"
-#include "ps2.h"
+#include "keyboard_extra.h"
+#include "gpio_extra.h"
+#include "gpio_interrupt.h"
+#include "ringbuf.h"
+#include "timer.h"
+#include <stddef.h>
+
+// A pause this long on the clock line ends any half-received scancode
+#define PS2_RESYNC_TICKS (2000 * TICKS_PER_USEC)
+
+static struct {
+    gpio_id_t clock, data;
+
+    // bit decoder, run on each falling clock edge
+    unsigned int nbits;         // bits of the current frame so far
+    unsigned int frame;         // bits received, LSB first
+    unsigned long last_edge;    // ticks at the previous edge
+
+    // decoded scancodes, interrupt -> main loop
+    unsigned char codes[KEYBOARD_QUEUE];
+    ringbuf_t queue;
+    unsigned int dropped;       // queue full or bad frame
+
+    // sequence assembly (keyboard_poll_event), across calls
+    bool release;               // F0 seen
+} module;
+
+// Falling edge of the PS/2 clock: the data line holds the next bit of the
+// 11-bit frame (start 0, 8 data bits LSB first, odd parity, stop 1)
+static void clock_edge(void *aux) {
+    gpio_interrupt_clear(module.clock);
+    unsigned long now = timer_get_ticks();
+    if (now - module.last_edge > PS2_RESYNC_TICKS) {
+        module.nbits = 0;
+        module.frame = 0;
+    }
+    module.last_edge = now;
 
-static ps2_device_t *dev;
+    unsigned int bit = gpio_read(module.data);
+    if (module.nbits == 0 && bit != 0) {
+        return;     // not a start bit: wait for one
+    }
+    module.frame |= bit << module.nbits;
+    if (++module.nbits < 11) {
+        return;
+    }
+
+    unsigned int frame = module.frame;
+    module.nbits = 0;
+    module.frame = 0;
+    unsigned char code = (frame >> 1) & 0xff;
+    unsigned int parity = 0;
+    for (unsigned int b = frame >> 1; b; b >>= 1) {
+        parity ^= b & 1;    // data, parity and stop bits: odd + stop = even
+    }
+    if (parity == 0 && (frame >> 10) == 1) {
+        if (!ringbuf_push(&module.queue, &code)) {
+            module.dropped++;
+        }
+    } else {
+        module.dropped++;
+    }
+}
 
 void keyboard_init(gpio_id_t clock_gpio, gpio_id_t data_gpio) {
-    dev = ps2_new(clock_gpio, data_gpio);
+    module.clock = clock_gpio;
+    module.data = data_gpio;
+    ringbuf_init(&module.queue, module.codes, 1, KEYBOARD_QUEUE);
+
+    gpio_set_input(module.clock);
+    gpio_set_pullup(module.clock);
+    gpio_set_input(module.data);
+    gpio_set_pullup(module.data);
+
+    gpio_interrupt_config(module.clock, GPIO_INTERRUPT_NEGATIVE_EDGE, false);
+    gpio_interrupt_register_handler(module.clock, clock_edge, NULL);
+    gpio_interrupt_enable(module.clock);
 }
 
 unsigned char keyboard_read_scancode(void) {
-    return ps2_read(dev);
+    unsigned char code;
+    while (!ringbuf_pop(&module.queue, &code)) {
+        // the clock interrupt fills the queue
+    }
+    return code;
 }
 
-key_action_t keyboard_read_sequence(void) {
-    key_action_t action;
-
-    // Label bytes
-    unsigned char first_byte, second_byte, third_byte;
-
-    // Read the first scancode
-    first_byte = keyboard_read_scancode();  
-
-    if (first_byte == 0xE0) { 
-        // Check for extended key prefix
-        second_byte = keyboard_read_scancode();  
-        
-        // Read the next byte
-        if (second_byte == 0xF0) {  
-            // Read the third byte
-            third_byte = keyboard_read_scancode(); 
-            action.what = KEY_RELEASE;
-            action.keycode = third_byte;
-
-        // Extended key press
-        } else {  
-            action.what = KEY_PRESS;
-            action.keycode = second_byte;
+// Assemble the next action from whatever scancodes are queued. A prefix
+// whose key byte has not arrived yet is remembered for the next call.
+static bool poll_sequence(key_action_t *action) {
+    unsigned char code;
+    while (ringbuf_pop(&module.queue, &code)) {
+        if (code == 0xE0) {
+            // Extended key prefix: same keycode as the plain key
+            continue;
         }
+        if (code == 0xF0) {
+            module.release = true;
+            continue;
+        }
+        action->what = module.release ? KEY_RELEASE : KEY_PRESS;
+        action->keycode = code;
+        module.release = false;
+        return true;
+    }
+    return false;
+}
 
-        // Normal key release
-    } else if (first_byte == 0xF0) {  
-        // Read the next byte
-        second_byte = keyboard_read_scancode();  
-        action.what = KEY_RELEASE;
-        action.keycode = second_byte;
-
-        // Normal key press
-    } else {  
-        action.what = KEY_PRESS;
-        action.keycode = first_byte;
+key_action_t keyboard_read_sequence(void) {
+    key_action_t action;
+    while (!poll_sequence(&action)) {
+        // wait for the rest of the sequence
     }
     return action;
 }
@@ -59,80 +122,70 @@ key_action_t keyboard_read_sequence(void) {
 // Variable to hold the current modifier state
 static keyboard_modifiers_t current_modifiers = 0;
 
-// keyboard_read_event implementation
-key_event_t keyboard_read_event(void) {
-    key_action_t action;
-    key_event_t event;
-
-    while (1) {
-        action = keyboard_read_sequence();
-
-        // Check if the action is a modifier key and update state
-        switch (ps2_keys[action.keycode].ch) {
-            // Shift
-            case PS2_KEY_SHIFT:
-                if (action.what == KEY_PRESS)
-                    // Enable
-                    current_modifiers |= KEYBOARD_MOD_SHIFT;
-                else if (action.what == KEY_RELEASE)
-                    // Disable
-                    current_modifiers &= ~KEYBOARD_MOD_SHIFT;
-
-                // Continue reading next action since this isn't a key event
-                continue;  
-
-            // Alt
-            case PS2_KEY_ALT:
-                if (action.what == KEY_PRESS)
-                    // Enable
-                    current_modifiers |= KEYBOARD_MOD_ALT;
-                else if (action.what == KEY_RELEASE)
-                    // Disable
-                    current_modifiers &= ~KEYBOARD_MOD_ALT;
-                continue;
-
-            // Ctrl
-            case PS2_KEY_CTRL:
-                if (action.what == KEY_PRESS)
-                    // Enable
-                    current_modifiers |= KEYBOARD_MOD_CTRL;
-                else if (action.what == KEY_RELEASE)
-                    // Disable
-                    current_modifiers &= ~KEYBOARD_MOD_CTRL;
-                continue;
-
-            // Caps
-            case PS2_KEY_CAPS_LOCK:
-                if (action.what == KEY_RELEASE)
-                    // Toggle CAPS LOCK state
-                    current_modifiers ^= KEYBOARD_MOD_CAPS_LOCK; 
-                continue;
-
-            default:
+// Update the modifier state with one action. Returns false for modifier
+// keys (they are not events of their own), else fills in the event.
+static bool make_event(key_action_t action, key_event_t *event) {
+    // Check if the action is a modifier key and update state
+    switch (ps2_keys[action.keycode].ch) {
+        // Shift
+        case PS2_KEY_SHIFT:
+            if (action.what == KEY_PRESS)
+                // Enable
+                current_modifiers |= KEYBOARD_MOD_SHIFT;
+            else if (action.what == KEY_RELEASE)
+                // Disable
+                current_modifiers &= ~KEYBOARD_MOD_SHIFT;
+
+            // Not a key event: the caller reads the next action
+            return false;
+
+        // Alt
+        case PS2_KEY_ALT:
+            if (action.what == KEY_PRESS)
+                // Enable
+                current_modifiers |= KEYBOARD_MOD_ALT;
+            else if (action.what == KEY_RELEASE)
+                // Disable
+                current_modifiers &= ~KEYBOARD_MOD_ALT;
+            return false;
+
+        // Ctrl
+        case PS2_KEY_CTRL:
+            if (action.what == KEY_PRESS)
+                // Enable
+                current_modifiers |= KEYBOARD_MOD_CTRL;
+            else if (action.what == KEY_RELEASE)
+                // Disable
+                current_modifiers &= ~KEYBOARD_MOD_CTRL;
+            return false;
+
+        // Caps
+        case PS2_KEY_CAPS_LOCK:
+            if (action.what == KEY_RELEASE)
+                // Toggle CAPS LOCK state
+                current_modifiers ^= KEYBOARD_MOD_CAPS_LOCK; 
+            return false;
+
+        default:
             // Does nothing for special keys
+            break;
+    }
 
-                /*
-                // If it's not a modifier key, process as a regular key event
-                if (ps2_keys[action.keycode].ch >= 0x90) {
-                    // Special keys
-                    continue;
-                }
-                */
-
-                break;
-        }
-
-        // If we reach here, a non-modifier key action has occurred
-        event.action = action;
-        event.key = ps2_keys[action.keycode];
-        event.modifiers = current_modifiers;
+    // If we reach here, a non-modifier key action has occurred
+    event->action = action;
+    event->key = ps2_keys[action.keycode];
+    event->modifiers = current_modifiers;
+    return true;
+}
 
-        // Handle repeat press events
-        if (action.what == KEY_PRESS || action.what == KEY_RELEASE) {
-            return event;
-        }
+// keyboard_read_event implementation
+key_event_t keyboard_read_event(void) {
+    key_event_t event;
 
+    while (!make_event(keyboard_read_sequence(), &event)) {
+        // skip modifier keys
     }
+    return event;
 }
 
 // Helper function to determine if a character is alphabetic
@@ -140,17 +193,8 @@ static int is_alpha(char ch) {
     return ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'));
 }
 
-unsigned char keyboard_read_next(void) {
-    key_event_t event;
-
-    // read events until a key press event
-    do {
-        event = keyboard_read_event();
-    } 
-
-    // Ignore key releases
-    while (event.action.what != KEY_PRESS);  
-
+// The character for a key press event, with Ctrl, Shift and Caps Lock applied
+static unsigned char event_char(key_event_t event) {
         // Handle Ctrl for extension
         // Check if Ctrl is pressed
     if (event.modifiers & KEYBOARD_MOD_CTRL) { 
@@ -205,3 +249,40 @@ unsigned char keyboard_read_next(void) {
     return event.key.ch;
 }
 
+unsigned char keyboard_read_next(void) {
+    key_event_t event;
+
+    // read events until a key press event
+    do {
+        event = keyboard_read_event();
+    } 
+
+    // Ignore key releases
+    while (event.action.what != KEY_PRESS);  
+
+    return event_char(event);
+}
+
+bool keyboard_poll_event(key_event_t *event) {
+    key_action_t action;
+    while (poll_sequence(&action)) {
+        if (make_event(action, event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int keyboard_poll_next(void) {
+    key_event_t event;
+    while (keyboard_poll_event(&event)) {
+        if (event.action.what == KEY_PRESS) {
+            return event_char(event);
+        }
+    }
+    return -1;
+}
+
+unsigned int keyboard_dropped(void) {
+    return module.dropped;
+}
@@ -0,0 +1,38 @@
+#ifndef KEYBOARD_EXTRA_H
+#define KEYBOARD_EXTRA_H
+
+#include <stdbool.h>
+#include "keyboard.h"
+
+/*
+ * Interrupt-driven keyboard input for main loops that have other work to
+ * do (redrawing, audio), alongside the blocking readers in keyboard.h.
+ *
+ * keyboard_init() hooks a GPIO interrupt on the falling edge of the PS/2
+ * clock line. The handler decodes the frame a bit at a time, checks
+ * parity and stop bit, and puts each scancode on a lock-free queue
+ * (ringbuf.h) that both the blocking readers and the poll functions take
+ * from. Call interrupts_init() and gpio_interrupt_init() before
+ * keyboard_init(), and enable interrupts before reading keys.
+ */
+
+// Scancodes buffered between the interrupt and the reader (power of two)
+#define KEYBOARD_QUEUE 64
+
+/*
+ * The next key event, with modifier tracking as in keyboard_read_event().
+ * Returns false right away if no complete event is queued; a sequence
+ * whose last scancode is still on the wire is finished on a later call.
+ */
+bool keyboard_poll_event(key_event_t *event);
+
+/*
+ * The next key press as keyboard_read_next() would return it, or -1 if
+ * none is queued. Modifier keys and key releases are consumed.
+ */
+int keyboard_poll_next(void);
+
+// Scancodes lost to a full queue or a bad frame, since keyboard_init
+unsigned int keyboard_dropped(void);
+
+#endif
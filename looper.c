@@ -0,0 +1,262 @@
+/* File: looper.c
+ * --------------
+ *  Multitrack looper with overdub and undo, on a fixed pool of chunks
+ */
+#include "looper.h"
+#include "arena.h"
+#include "strings.h"
+
+// Tracks are stored in chunks. Each layer (the take, and the undo layer)
+// is a table of chunk pointers: NULL is silence, and the two layers share
+// a chunk until one of them is written. Every chunk has two slots in the
+// pool, so a write to a shared or silent chunk takes whichever slot the
+// undo layer is not using. Saving, swapping or clearing a layer is then
+// a pass over the pointer table, cheap enough for the DMA interrupt, and
+// the samples are copied a chunk at a time as the playhead writes them.
+#define LOOPER_CHUNK_FRAMES 4096
+
+struct track {
+    int16_t **audio;    // nchunks chunk pointers for the take
+    int16_t **undo;     // previous take, swapped in by undo
+    int16_t *slots;     // 2 * nchunks chunks
+    looper_mode_t mode;
+    bool muted;
+    bool has_audio;
+    bool undo_has_audio;
+};
+
+struct looper_state {
+    int ntracks;
+    unsigned int max_frames;
+    unsigned int loop_frames;
+    unsigned int nchunks;       // chunks in max_frames
+    unsigned int pos;           // shared playhead
+    struct track tracks[LOOPER_MAX_TRACKS];
+    sample_t mix[EFFECT_MAX_BLOCK];
+    int16_t *pool;              // 2 * ntracks * nchunks chunks
+};
+
+static inline int16_t to_i16(sample_t s) {
+    int64_t v = ((int64_t)s + (1 << (SAMPLE_FRAC_BITS - 16))) >> (SAMPLE_FRAC_BITS - 15);
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+// Chunk c of the take, made private to it so it can be written: a silent
+// chunk becomes a zeroed one, a chunk shared with the undo layer is copied
+static int16_t *writable_chunk(struct track *tr, unsigned int c) {
+    int16_t *chunk = tr->audio[c];
+    if (chunk && chunk != tr->undo[c]) {
+        return chunk;
+    }
+    int16_t *slot = tr->slots + 2 * c * LOOPER_CHUNK_FRAMES;
+    int16_t *fresh = tr->undo[c] == slot ? slot + LOOPER_CHUNK_FRAMES : slot;
+    if (chunk) {
+        memcpy(fresh, chunk, LOOPER_CHUNK_FRAMES * sizeof(int16_t));
+    } else {
+        memset(fresh, 0, LOOPER_CHUNK_FRAMES * sizeof(int16_t));
+    }
+    tr->audio[c] = fresh;
+    return fresh;
+}
+
+// One run of the loop within a single chunk: [pos, pos + n)
+static void process_run(struct looper_state *st, sample_t *block, int n) {
+    unsigned int c = st->pos / LOOPER_CHUNK_FRAMES;
+    unsigned int offset = st->pos % LOOPER_CHUNK_FRAMES;
+
+    // audible tracks first, from what they held before this block
+    memset(st->mix, 0, n * sizeof(sample_t));
+    for (int t = 0; t < st->ntracks; t++) {
+        struct track *tr = &st->tracks[t];
+        if (!tr->has_audio || tr->muted || tr->mode == LOOPER_RECORD || !tr->audio[c]) {
+            continue;
+        }
+        const int16_t *src = tr->audio[c] + offset;
+        for (int i = 0; i < n; i++) {
+            st->mix[i] += sample_from_i16(src[i]);
+        }
+    }
+
+    // then take the live input into the recording tracks
+    for (int t = 0; t < st->ntracks; t++) {
+        struct track *tr = &st->tracks[t];
+        if (tr->mode == LOOPER_RECORD) {
+            int16_t *dst = writable_chunk(tr, c) + offset;
+            for (int i = 0; i < n; i++) {
+                dst[i] = to_i16(block[i]);
+            }
+        } else if (tr->mode == LOOPER_OVERDUB) {
+            int16_t *dst = writable_chunk(tr, c) + offset;
+            for (int i = 0; i < n; i++) {
+                dst[i] = to_i16(sample_add(sample_from_i16(dst[i]), block[i]));
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        block[i] = sample_add(block[i], st->mix[i]);
+    }
+}
+
+static void looper_process(effect_t *fx, sample_t *block, int n) {
+    struct looper_state *st = fx->state;
+    if (st->loop_frames == 0) {
+        return;
+    }
+    while (n > 0) {
+        // up to the end of the loop or of the chunk, whichever is first
+        int run = st->loop_frames - st->pos;
+        int chunk_left = LOOPER_CHUNK_FRAMES - st->pos % LOOPER_CHUNK_FRAMES;
+        if (run > chunk_left) {
+            run = chunk_left;
+        }
+        if (run > n) {
+            run = n;
+        }
+        process_run(st, block, run);
+        block += run;
+        n -= run;
+        st->pos += run;
+        if (st->pos == st->loop_frames) {
+            st->pos = 0;
+        }
+    }
+}
+
+effect_t *effect_looper_new(int ntracks, unsigned int max_frames) {
+    if (ntracks > LOOPER_MAX_TRACKS) {
+        ntracks = LOOPER_MAX_TRACKS;
+    }
+    size_t mark = arena_mark(&audio_arena);
+    unsigned int nchunks = (max_frames + LOOPER_CHUNK_FRAMES - 1) / LOOPER_CHUNK_FRAMES;
+    struct looper_state *st = arena_alloc(&audio_arena, sizeof(struct looper_state));
+    int16_t *pool = arena_alloc(&audio_arena, 2 * ntracks * nchunks * LOOPER_CHUNK_FRAMES * sizeof(int16_t));
+    int16_t **tables = arena_alloc(&audio_arena, 2 * ntracks * nchunks * sizeof(int16_t *));
+    effect_t *fx = st && pool && tables ? effect_new("looper", NULL, st) : NULL;
+    if (!fx) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    memset(st, 0, sizeof(struct looper_state));
+    st->ntracks = ntracks;
+    st->max_frames = max_frames;
+    st->nchunks = nchunks;
+    st->pool = pool;
+
+    // carve every track's slots and layer tables out of the pool
+    for (int t = 0; t < ntracks; t++) {
+        st->tracks[t].slots = st->pool + 2 * t * st->nchunks * LOOPER_CHUNK_FRAMES;
+        st->tracks[t].audio = tables + 2 * t * st->nchunks;
+        st->tracks[t].undo = tables + (2 * t + 1) * st->nchunks;
+    }
+    fx->process = looper_process;
+    effect_looper_set_length(fx, max_frames);
+    return fx;
+}
+
+static void silence(struct looper_state *st, int16_t **layer) {
+    for (unsigned int c = 0; c < st->nchunks; c++) {
+        layer[c] = NULL;
+    }
+}
+
+void effect_looper_set_length(effect_t *fx, unsigned int frames) {
+    struct looper_state *st = fx->state;
+    st->loop_frames = frames < st->max_frames ? frames : st->max_frames;
+    st->pos = 0;
+    for (int t = 0; t < st->ntracks; t++) {
+        struct track *tr = &st->tracks[t];
+        tr->mode = LOOPER_PLAY;
+        tr->has_audio = tr->undo_has_audio = false;
+        silence(st, tr->audio);
+        silence(st, tr->undo);
+    }
+}
+
+static struct track *get_track(effect_t *fx, int track) {
+    struct looper_state *st = fx->state;
+    return track >= 0 && track < st->ntracks ? &st->tracks[track] : NULL;
+}
+
+// Keep the current take as the undo layer before changing it: the layers
+// share every chunk until the take is written
+static void save_undo(struct looper_state *st, struct track *tr) {
+    memcpy(tr->undo, tr->audio, st->nchunks * sizeof(int16_t *));
+    tr->undo_has_audio = tr->has_audio;
+}
+
+void effect_looper_record(effect_t *fx, int track) {
+    struct looper_state *st = fx->state;
+    struct track *tr = get_track(fx, track);
+    if (tr && tr->mode == LOOPER_PLAY) {
+        save_undo(st, tr);
+        if (!tr->has_audio) {
+            // whatever the loop does not reach before recording stops is silence
+            silence(st, tr->audio);
+            tr->has_audio = true;
+        }
+        tr->mode = LOOPER_RECORD;
+    }
+}
+
+void effect_looper_overdub(effect_t *fx, int track) {
+    struct looper_state *st = fx->state;
+    struct track *tr = get_track(fx, track);
+    if (tr && tr->mode == LOOPER_PLAY) {
+        save_undo(st, tr);
+        if (!tr->has_audio) {
+            // overdubbing an empty track is recording onto silence
+            silence(st, tr->audio);
+            tr->has_audio = true;
+        }
+        tr->mode = LOOPER_OVERDUB;
+    }
+}
+
+void effect_looper_play(effect_t *fx, int track) {
+    struct track *tr = get_track(fx, track);
+    if (tr) {
+        tr->mode = LOOPER_PLAY;
+    }
+}
+
+void effect_looper_mute(effect_t *fx, int track, bool muted) {
+    struct track *tr = get_track(fx, track);
+    if (tr) {
+        tr->muted = muted;
+    }
+}
+
+void effect_looper_undo(effect_t *fx, int track) {
+    struct track *tr = get_track(fx, track);
+    if (!tr) {
+        return;
+    }
+    int16_t **audio = tr->audio;
+    bool has_audio = tr->has_audio;
+    tr->audio = tr->undo;
+    tr->has_audio = tr->undo_has_audio;
+    tr->undo = audio;
+    tr->undo_has_audio = has_audio;
+    tr->mode = LOOPER_PLAY;
+}
+
+void effect_looper_clear(effect_t *fx, int track) {
+    struct track *tr = get_track(fx, track);
+    if (tr) {
+        save_undo(fx->state, tr);
+        silence(fx->state, tr->audio);
+        tr->has_audio = false;
+        tr->mode = LOOPER_PLAY;
+    }
+}
+
+looper_mode_t effect_looper_mode(effect_t *fx, int track) {
+    struct track *tr = get_track(fx, track);
+    return tr ? tr->mode : LOOPER_PLAY;
+}
+
+bool effect_looper_has_audio(effect_t *fx, int track) {
+    struct track *tr = get_track(fx, track);
+    return tr && tr->has_audio;
+}
@@ -0,0 +1,54 @@
+#ifndef LOOPER_H
+#define LOOPER_H
+
+#include "effects.h"
+
+/*
+ * Multitrack looper stage. All tracks share one loop length and one
+ * playhead. A track can record (replace), overdub (add to what is there),
+ * be muted, and undo its last take. The stage passes the live signal
+ * through and mixes every audible track into it in one pass per track;
+ * put it before the backing stage so the backing track is heard but not
+ * recorded.
+ *
+ * Track storage (16-bit, plus one undo layer per track) comes from a
+ * single pool taken from the audio arena when the stage is created,
+ * sized for the longest loop, so recording and overdubbing never allocate.
+ * The layers are tables of fixed-size chunks shared until written, so
+ * every control below is a pass over a small pointer table: they are
+ * cheap enough to call from the DMA interrupt, between blocks. Samples
+ * are copied a chunk at a time as recording reaches them.
+ */
+
+#define LOOPER_MAX_TRACKS 8
+
+typedef enum {
+    LOOPER_PLAY,        // play the track (if it has audio)
+    LOOPER_RECORD,      // replace the track with the input
+    LOOPER_OVERDUB,     // play the track and add the input to it
+} looper_mode_t;
+
+/*
+ * @param ntracks       up to LOOPER_MAX_TRACKS
+ * @param max_frames    longest loop the pool has room for
+ */
+effect_t *effect_looper_new(int ntracks, unsigned int max_frames);
+
+// Set the loop length (<= max_frames); clears every track and the playhead
+void effect_looper_set_length(effect_t *fx, unsigned int frames);
+
+// Start recording or overdubbing a track (saving its undo layer), or go back to play
+void effect_looper_record(effect_t *fx, int track);
+void effect_looper_overdub(effect_t *fx, int track);
+void effect_looper_play(effect_t *fx, int track);
+
+void effect_looper_mute(effect_t *fx, int track, bool muted);
+
+// Swap a track with its undo layer (undoing twice redoes)
+void effect_looper_undo(effect_t *fx, int track);
+void effect_looper_clear(effect_t *fx, int track);
+
+looper_mode_t effect_looper_mode(effect_t *fx, int track);
+bool effect_looper_has_audio(effect_t *fx, int track);
+
+#endif
@@ -9,180 +9,309 @@
 #include "uart.h"
 #include "malloc.h"
 #include "dma.h"
+#include "interrupts.h"
+#include "gpio_interrupt.h"
+#include "effects.h"
+#include "compressor.h"
+#include "reverb.h"
+#include "looper.h"
+#include "session.h"
+#include "arena.h"
+#include "stream.h"
+#include "ringbuf.h"
 #include "strings.h"
 #include <stdint.h>
-#include "THX.h"
+#include "THX_adpcm.h"
+
+#define LOOPER_TRACKS 4            // the UI's track keys run 1 to this
 
 #include "UI.c"
 
-uint16_t levels(uint16_t sample) {    
-    if (config.level == 0) {
-        return 0;
+static effect_chain_t *chain;
+static level_params_t level_params;
+static compressor_params_t compressor_params;
+static reverb_params_t reverb_params;
+static backing_params_t backing_params;
+static effect_t *compressor_fx, *reverb_fx, *level_fx, *looper_fx, *backing_fx;
+
+#define MAX_RECORDING_SECONDS 10   // top of the Length knob
+
+// Build the effect chain: compressor -> reverb -> levels -> looper -> backing track;
+// false if the audio arena has no room for it
+static bool mixer_init(void) {
+    chain = effect_chain_new(STREAM_PERIOD_FRAMES);
+
+    backing_params.track = &THX_adpcm;
+    backing_params.at_end = ADPCM_LOOP;
+
+    compressor_fx = effect_compressor_new(&compressor_params);
+    reverb_fx = effect_reverb_new(&reverb_params);
+    level_fx = effect_level_new(&level_params);
+    looper_fx = effect_looper_new(LOOPER_TRACKS, MAX_RECORDING_SECONDS * STREAM_SAMPLE_RATE);
+    backing_fx = effect_backing_new(&backing_params);
+    if (!chain || !compressor_fx || !reverb_fx || !level_fx || !looper_fx || !backing_fx) {
+        return false;
+    }
+
+    effect_chain_append(chain, compressor_fx);
+    effect_chain_append(chain, reverb_fx);
+    effect_chain_append(chain, level_fx);
+    effect_chain_append(chain, looper_fx);
+    effect_chain_append(chain, backing_fx);
+    return true;
+}
+
+// Copy the knob settings into the stages (they resolve them once per block)
+static void apply_config(const mixer_config_t *cfg) {
+    level_params.level = cfg->level;
+
+    // Threshold knob: 20 is off, each step down lowers the threshold 6 dB
+    int ratio = cfg->compression_ratio > 1 ? cfg->compression_ratio : 4;
+    compressor_params.threshold_db = (cfg->compression_threshold - 20) * 6 / 5;
+    compressor_params.ratio = ratio;
+    compressor_params.knee_db = 6;
+    compressor_params.attack_ms = 5;
+    compressor_params.release_ms = 80;
+    // make up half of the reduction a full-scale signal gets
+    compressor_params.makeup_db = -compressor_params.threshold_db * (ratio - 1) / (2 * ratio);
+    compressor_params.detector = COMPRESSOR_PEAK;
+    compressor_fx->bypass = (cfg->compression_threshold == 20);
+
+    reverb_params.room_size = 50;
+    reverb_params.damping = 50;
+    reverb_params.wet = 33;
+    reverb_params.dry = 100;
+    reverb_fx->bypass = !cfg->reverb;
+    backing_fx->bypass = !cfg->backing_track;
+    looper_fx->bypass = !cfg->live;
+}
+
+// What the audio engine is doing while the UI keeps running
+typedef enum {
+    MIXER_IDLE,
+    MIXER_LIVE,         // duplex stream, processed in the DMA interrupt
+    MIXER_CAPTURING,    // one-shot mic capture of a take
+    MIXER_PLAYING,      // one-shot playback of the processed take
+} mixer_state_t;
+
+static mixer_state_t state;
+static audio_buffer_t *take;
+
+// Knob settings on their way from the UI to live_block, which runs in the
+// DMA interrupt: the chain's parameters are only ever written there
+#define SETTINGS_QUEUE 4
+static mixer_config_t settings_slots[SETTINGS_QUEUE];
+static ringbuf_t settings_queue;
+static bool settings_pending;    // changed, not yet queued (queue was full)
+
+// Looper keys, also handed to live_block, in order
+typedef struct {
+    ui_action_t op;     // UI_LOOP_*
+    int track;
+    bool muted;         // for UI_LOOP_MUTE
+} looper_command_t;
+
+#define LOOPER_QUEUE 8
+static looper_command_t looper_slots[LOOPER_QUEUE];
+static ringbuf_t looper_queue;
+static bool looper_muted[LOOPER_TRACKS];
+
+static void run_looper_command(const looper_command_t *cmd) {
+    switch (cmd->op) {
+        case UI_LOOP_RECORD: effect_looper_record(looper_fx, cmd->track); break;
+        case UI_LOOP_OVERDUB: effect_looper_overdub(looper_fx, cmd->track); break;
+        case UI_LOOP_PLAY: effect_looper_play(looper_fx, cmd->track); break;
+        case UI_LOOP_MUTE: effect_looper_mute(looper_fx, cmd->track, cmd->muted); break;
+        case UI_LOOP_UNDO: effect_looper_undo(looper_fx, cmd->track); break;
+        case UI_LOOP_CLEAR: effect_looper_clear(looper_fx, cmd->track); break;
+        default: break;
+    }
+}
+
+// Effects applied to each captured period in live mode
+static void live_block(uint32_t *words, int nframes, void *aux) {
+    static mixer_config_t settings;
+    bool changed = false;
+    while (ringbuf_pop(&settings_queue, &settings)) {
+        changed = true;     // only the newest matters
     }
-    if (config.level == -2) {
-        sample = (uint16_t)(sample / 2);
+    if (changed) {
+        apply_config(&settings);
     }
-    else {
-        sample = (uint16_t)(sample * config.level);
+    looper_command_t cmd;
+    while (ringbuf_pop(&looper_queue, &cmd)) {
+        run_looper_command(&cmd);
     }
-    return sample;
+    effect_chain_process_words(chain, words, nframes);
 }
 
-uint16_t compression(int sample) {
-    int threshold;
-    if (config.compression_threshold == 20) {
-        return sample;
-    }   
-    if (config.compression_threshold == 15) {
-       threshold = 0xa000;
-    }   
-    if (config.compression_threshold == 10) {
-        threshold = 0x6000;
-    }   
-    if (config.compression_threshold == 5) {
-        threshold = 0x1000;
-    }   
-    if (config.compression_threshold == 0) {
-        threshold = 0;
-    }   
-
-    if ((sample < threshold)) {
-        sample = threshold + (int)((sample - threshold) / 10);
-    }   
-    return sample;
+// Capture, process and play back continuously until live_stop; false if
+// the stream could not get its DMA channels
+static bool live_start(void) {
+    // 24-bit output: the duplex frame has 32-bit slots, so the DAC gets
+    // the chain's full precision instead of a 16-bit truncation
+    audio_duplex_init(44100);
+    i2s_set_resolution(24);
+    effect_chain_set_output_bits(chain, 24);
+    // loops are as long as the Length knob says
+    effect_looper_set_length(looper_fx, config.length_of_recording * STREAM_SAMPLE_RATE);
+
+    // the stream is stopped, so nothing is consuming the queue yet
+    ringbuf_init(&settings_queue, settings_slots, sizeof(mixer_config_t), SETTINGS_QUEUE);
+    settings_pending = false;
+    ringbuf_init(&looper_queue, looper_slots, sizeof(looper_command_t), LOOPER_QUEUE);
+    memset(looper_muted, 0, sizeof(looper_muted));
+    apply_config(&config);
+
+    stream_init(NULL, live_block, NULL);
+    stream_process_in_irq(true);
+    if (!stream_start()) {
+        printf("live: could not start the stream (no DMA channels free)\n");
+        effect_chain_set_output_bits(chain, 16);
+        return false;
+    }
+    printf("live: %d us input-to-output latency\n", stream_latency_us());
+    return true;
 }
 
-uint16_t backingtrack(uint16_t sample, int idx) {
-    if (config.backing_track == false) {
-        return sample;
+static void live_stop(void) {
+    stream_stop();
+    stream_stats_t stats = stream_get_stats();
+    printf("live: %d periods, %d underruns, %d overruns\n", stats.periods, stats.underruns, stats.overruns);
+    effect_chain_set_output_bits(chain, 16);
+}
+
+// Start recording a take into the session buffer; the main loop picks
+// up its completion. False if the capture could not start
+static bool take_start(void) {
+    printf("starting mic read\n");
+    take = session_begin_take(config.length_of_recording);
+
+    // capture needs the mic's frame back after the previous take's playback
+    mic_init(44100);
+    if (!audio_capture_dma(take)) {
+        printf("could not start the capture (no DMA channel free)\n");
+        return false;
     }
-    int backing = pcm_data[idx];
-    return ((uint16_t) (sample + backing));
+    return true;
 }
 
+// The capture finished: process the take in place and start playing it;
+// false if the playback could not start
+static bool take_captured(void) {
+    dma_disable(dma_mic_channel());
+    printf("Collection finished!\n");
+    // run the effect chain over the capture buffer in place
+    apply_config(&config);
+    session_process_take();
+
+    // the audio clock stays locked from capture, so this only reprograms I2S2
+    audio_init(44100, 2, MONO);
+    // audio_init(44100, 2, STEREO); // want to test
+    printf("switched to playback in %d us\n", i2s_setup_us());
+
+    printf("starting play\n");
+    if (!audio_play_dma(take)) {
+        printf("could not start playback (no DMA channel free)\n");
+        return false;
+    }
+    return true;
+}
+
+static void take_played(void) {
+    dma_disable(dma_dac_channel());
+    printf("done playing (take %d)\n", session_take_count());
+}
+
+// Start or stop whatever the key asked for, if the engine is free for it
+static void handle_action(ui_action_t action) {
+    if (action == UI_LIVE && state == MIXER_LIVE) {
+        live_stop();
+        config.live = false;
+        state = MIXER_IDLE;
+    } else if (action == UI_LIVE && state == MIXER_IDLE) {
+        config.live = true;
+        print_config_values();
+        if (live_start()) {
+            state = MIXER_LIVE;
+        } else {
+            config.live = false;
+        }
+    } else if (action == UI_RECORD && state == MIXER_IDLE) {
+        config.live = false;
+        print_config_values();
+        if (take_start()) {
+            state = MIXER_CAPTURING;
+        }
+    } else if (action >= UI_LOOP_RECORD && state == MIXER_LIVE) {
+        looper_command_t cmd = {.op = action, .track = ui.track, .muted = !looper_muted[ui.track]};
+        // a key pressed faster than periods go by is dropped
+        if (ringbuf_push(&looper_queue, &cmd) && action == UI_LOOP_MUTE) {
+            looper_muted[ui.track] = cmd.muted;
+        }
+    }
+}
+
+// Advance a take when its one-shot transfer finishes
+static void handle_completions(void) {
+    int channel;
+    while ((channel = dma_completion_next()) >= 0) {
+        if (state == MIXER_CAPTURING && channel == dma_mic_channel()) {
+            state = take_captured() ? MIXER_PLAYING : MIXER_IDLE;
+        } else if (state == MIXER_PLAYING && channel == dma_dac_channel()) {
+            take_played();
+            state = MIXER_IDLE;
+        }
+    }
+}
+
+static const char *const state_names[] = {
+    [MIXER_IDLE] = "Ready",
+    [MIXER_LIVE] = "Live Mixing",
+    [MIXER_CAPTURING] = "Recording Audio",
+    [MIXER_PLAYING] = "Playing Audio",
+};
 
 void main () {
     uart_init();
-    keyboard_init(KEYBOARD_CLOCK, KEYBOARD_DATA);
     gl_init(WIDTH, HEIGHT, GL_DOUBLEBUFFER);
     gpio_init();
     i2s_init();
-    mic_init();
-    run();
-
-    /*
-    // debug------------------------
-    config.level = 1;
-    config.compression_threshold = 10;
-    config.backing_track = false;
-    config.length_of_recording = 5;
-    config.reverb = false;
-    // debug------------------------
-    */
-
-    printf("starting mic read\n");
-    const int num_samples = (44100 * config.length_of_recording); // sameple rate = 44100
-    
-    uint32_t *audio_samples = malloc(num_samples * sizeof(uint32_t) + 400);
-    
-    gl_clear(gl_color(0x30, 0x30, 0x30)); // create dark gray color
-    int press_space_text_x = WIDTH / 2 - (strlen("Recording Audio") * 14) / 2; // Adjusted for character width
-    gl_draw_string(press_space_text_x, HEIGHT/2, "Recording Audio", GL_WHITE); // white text
-
-    gl_swap_buffer();
+    if (!mixer_init()) {
+        printf("mixer: the effect chain does not fit in the audio arena\n");
+        arena_report_all();
+        return;
+    }
+    // every take reuses the one buffer sized for the longest recording
+    session_init(chain, 44100, MAX_RECORDING_SECONDS);
+    arena_report_all();
+    audio_convert_report(8 * STREAM_PERIOD_FRAMES);
+    interrupts_init();
+    gpio_interrupt_init();
+    keyboard_init(KEYBOARD_CLOCK, KEYBOARD_DATA);
+    dma_interrupts_init();
 
-    mic_capture_dma(audio_samples, num_samples);
-    dma_mic_start();
+    // From here on the keyboard and DMA are interrupt driven and nothing
+    // blocks: the UI, live settings and take transfers all advance a
+    // little every pass of the loop
+    interrupts_global_enable();
+    // nothing else runs yet, so the intro can wait on the keyboard
+    intro();
+    while (1) {
+        handle_action(ui_poll());
 
-    int count = 0;
+        if (ui_settings_changed()) {
+            print_config_values();
+            settings_pending = (state == MIXER_LIVE);
+        }
+        if (settings_pending && ringbuf_push(&settings_queue, &config)) {
+            settings_pending = false;
+        }
 
-    while (1) {
-        printf("doing other stuff count: %d\n", count);
-        count++;
-        if (dma_complete(1)) {
-            dma_disable(1);
-            printf("Collection finished!\n");
-            // convert to 16-bit samples
-            uint16_t *converted_samples = malloc(num_samples * sizeof(uint16_t));
-            uint16_t *reverb_buffer = malloc(num_samples * sizeof(uint16_t) + 4800);
-            memset(reverb_buffer, 0, (num_samples * sizeof(uint16_t) + 4800));
-            
-
-
-            for (int i = 0; i < num_samples; i++) {
-                converted_samples[i] = audio_samples[i] >> 16;
-                converted_samples[i] = compression(converted_samples[i]); // more of a clipping limiter
-
-                // reverb
-                if (config.reverb) {
-                    reverb_buffer[i] += converted_samples[i];
-                    reverb_buffer[i + (44 * 36)] += (int)(converted_samples[i] / 2);
-                    reverb_buffer[i + (44 * 72)] += (int)(converted_samples[i] / 4);
-                    reverb_buffer[i + (44 * 108)] += (int)(converted_samples[i] / 8);
-                }
-
-                converted_samples[i] = levels(converted_samples[i]);
-
-                // backing track
-                if (config.reverb) {
-                    reverb_buffer[i] = backingtrack(reverb_buffer[i], i);
-                    // make intro & outro clipping less awful (still not great)
-                    if (i < 11000) {
-                         reverb_buffer[i] = 0;
-                    }
-                    if (i > (num_samples - 8000)) {
-                        reverb_buffer[i] = 0;
-                    }
-                }
-                else {
-                    converted_samples[i] = backingtrack(converted_samples[i], i);
-                    // make intro & outro clipping less awful (still not great)
-                    if (i < 11000) {
-                        converted_samples[i] = 0;
-                    }
-                    if (i > (num_samples - 8000)) {
-                        converted_samples[i] = 0;
-                    }
-                }
-            }
-
-
-            free(audio_samples);
-            i2s_init();
-
-            audio_init(44100, 2, MONO);
-            // audio_init(44100, 2, STEREO); // want to test
-            printf("1 second pause...\n");
-            timer_delay_ms(1000);
-
-            gl_clear(gl_color(0x30, 0x30, 0x30)); // create dark gray color
-            int press_space_text_x = WIDTH / 2 - (strlen("Playing Audio") * 14) / 2; // Adjusted for character width
-            gl_draw_string(press_space_text_x, HEIGHT/2, "Playing Audio", GL_WHITE); // white text
-
-            gl_swap_buffer();
-
-
-            printf("starting play\n");
-            if (config.reverb) {
-                audio_write_i16_dma(reverb_buffer, num_samples, 0);
-                while (!dma_complete(0)) {
-                    printf("playing reverb audio\n");
-                }
-                dma_disable(0);
-            }
-            else {
-                audio_write_i16_dma(converted_samples, num_samples, 0);
-                while (!dma_complete(0)) {
-                    printf("playing audio\n");
-                }
-                dma_disable(0);
-            }
-            printf("done playing\n");
-            free(converted_samples);
-            //free(reverb_buffer);
-            //instructions_counter = 1;
-            break;
+        if (state == MIXER_LIVE) {
+            stream_poll();
         }
-        
+        handle_completions();
+        ui_set_status(state_names[state]);
     }
 }
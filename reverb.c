@@ -0,0 +1,136 @@
+/* File: reverb.c
+ * --------------
+ *  Fixed-point Freeverb (comb/allpass network) on bounded delay lines
+ */
+#include "reverb.h"
+#include "arena.h"
+#include "strings.h"
+
+#define NUM_COMBS 8
+#define NUM_ALLPASSES 4
+
+// Freeverb delay lengths (samples at 44.1 kHz)
+#define COMB_TOTAL (1116 + 1188 + 1277 + 1356 + 1422 + 1491 + 1557 + 1617)
+#define ALLPASS_TOTAL (556 + 441 + 341 + 225)
+static const int comb_lengths[NUM_COMBS] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+static const int allpass_lengths[NUM_ALLPASSES] = {556, 441, 341, 225};
+
+// Delay lines hold Q23 samples (16-bit audio with 8 extra fraction bits)
+#define NETWORK_FRAC_BITS 23
+// Input to the network is clipped to +-16x full scale, so 8 combs at the
+// highest feedback cannot overflow the 32-bit lines
+#define NETWORK_IN_MAX (16 * INPUT_GAIN_Q15 << (NETWORK_FRAC_BITS - 15))
+// Freeverb's fixed input gain (0.015) in Q15
+#define INPUT_GAIN_Q15 492
+
+// Q15 multiply that truncates toward zero, so the feedback loops decay to
+// silence instead of settling into a small limit cycle
+static inline int32_t mul_q15(int32_t x, int32_t coef) {
+    int64_t p = (int64_t)x * coef;
+    return (int32_t)(p < 0 ? -(-p >> 15) : p >> 15);
+}
+
+struct delay {
+    int32_t *buf;
+    int len;
+    int pos;
+};
+
+struct reverb_state {
+    // coefficients, Q15
+    int32_t feedback;
+    int32_t damp1;
+    int32_t damp2;
+    int32_t wet;
+    int32_t dry;
+
+    struct delay combs[NUM_COMBS];
+    int32_t comb_store[NUM_COMBS];  // one-pole lowpass state per comb
+    struct delay allpasses[NUM_ALLPASSES];
+
+    int32_t memory[COMB_TOTAL + ALLPASS_TOTAL];
+};
+
+static void reverb_prepare(effect_t *fx) {
+    reverb_params_t *params = fx->params;
+    struct reverb_state *st = fx->state;
+
+    // same ranges as Freeverb: feedback 0.7..0.98, damping 0..0.4, wet up to 3x
+    st->feedback = 22938 + 9175 * params->room_size / 100;
+    st->damp1 = 13107 * params->damping / 100;
+    st->damp2 = 32768 - st->damp1;
+    st->wet = 3 * 32768 * params->wet / 100;
+    st->dry = 32768 * params->dry / 100;
+}
+
+static void reverb_process(effect_t *fx, sample_t *block, int n) {
+    struct reverb_state *st = fx->state;
+    int32_t feedback = st->feedback;
+    int32_t damp1 = st->damp1;
+    int32_t damp2 = st->damp2;
+
+    for (int i = 0; i < n; i++) {
+        int64_t scaled = ((int64_t)block[i] * INPUT_GAIN_Q15) >> (15 + SAMPLE_FRAC_BITS - NETWORK_FRAC_BITS);
+        int32_t in = scaled > NETWORK_IN_MAX ? NETWORK_IN_MAX : scaled < -NETWORK_IN_MAX ? -NETWORK_IN_MAX : (int32_t)scaled;
+        int32_t acc = 0;
+
+        for (int c = 0; c < NUM_COMBS; c++) {
+            struct delay *d = &st->combs[c];
+            int32_t out = d->buf[d->pos];
+            st->comb_store[c] = mul_q15(out, damp2) + mul_q15(st->comb_store[c], damp1);
+            d->buf[d->pos] = in + mul_q15(st->comb_store[c], feedback);
+            if (++d->pos == d->len) {
+                d->pos = 0;
+            }
+            acc += out;
+        }
+
+        for (int a = 0; a < NUM_ALLPASSES; a++) {
+            struct delay *d = &st->allpasses[a];
+            int32_t bufout = d->buf[d->pos];
+            d->buf[d->pos] = acc + bufout / 2;
+            acc = bufout - acc;
+            if (++d->pos == d->len) {
+                d->pos = 0;
+            }
+        }
+
+        int64_t wet = (int64_t)acc << (SAMPLE_FRAC_BITS - NETWORK_FRAC_BITS);
+        block[i] = sample_sat(((int64_t)block[i] * st->dry + wet * st->wet) >> 15);
+    }
+}
+
+void effect_reverb_reset(effect_t *fx) {
+    struct reverb_state *st = fx->state;
+    memset(st->memory, 0, sizeof(st->memory));
+    memset(st->comb_store, 0, sizeof(st->comb_store));
+}
+
+effect_t *effect_reverb_new(reverb_params_t *params) {
+    size_t mark = arena_mark(&audio_arena);
+    struct reverb_state *st = arena_alloc(&audio_arena, sizeof(struct reverb_state));
+    effect_t *fx = st ? effect_new("reverb", params, st) : NULL;
+    if (!fx) {
+        arena_release(&audio_arena, mark);
+        return NULL;
+    }
+    memset(st, 0, sizeof(struct reverb_state));
+
+    // carve every delay line out of the one fixed block
+    int32_t *next = st->memory;
+    for (int c = 0; c < NUM_COMBS; c++) {
+        st->combs[c].buf = next;
+        st->combs[c].len = comb_lengths[c];
+        next += comb_lengths[c];
+    }
+    for (int a = 0; a < NUM_ALLPASSES; a++) {
+        st->allpasses[a].buf = next;
+        st->allpasses[a].len = allpass_lengths[a];
+        next += allpass_lengths[a];
+    }
+
+    fx->prepare = reverb_prepare;
+    fx->process = reverb_process;
+    fx->reset = effect_reverb_reset;
+    return fx;
+}
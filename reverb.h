@@ -0,0 +1,25 @@
+#ifndef REVERB_H
+#define REVERB_H
+
+#include "effects.h"
+
+/*
+ * Freeverb-style reverb: eight damped feedback combs in parallel into
+ * four series allpasses, all on fixed-size circular delay lines. Memory
+ * is allocated once when the stage is created, so it does not grow with
+ * recording length, and the stage runs block by block in the live path.
+ */
+
+typedef struct {
+    int room_size;  // 0..100, comb feedback
+    int damping;    // 0..100, high-frequency loss in the tail
+    int wet;        // 0..100, reverb level
+    int dry;        // 0..100, direct signal level (100 = unity)
+} reverb_params_t;
+
+effect_t *effect_reverb_new(reverb_params_t *params);
+
+// Clear the delay lines so the next take starts without a tail
+void effect_reverb_reset(effect_t *fx);
+
+#endif
@@ -0,0 +1,101 @@
+/* File: ringbuf.c
+ * ---------------
+ *  Single-producer/single-consumer ring with RISC-V fences
+ */
+#include "ringbuf.h"
+#include "strings.h"
+
+// Order slot accesses against index updates. On the D1 the other side
+// is an interrupt handler on the same hart (or a DMA-aware driver), but
+// the fences also keep the compiler from moving slot accesses across the
+// index load/store. Host builds use the equivalent C11 fences so the
+// stress test can run the two sides on separate threads.
+static inline void acquire_fence(void) {
+#ifdef __riscv
+    __asm__ volatile("fence r, rw" ::: "memory");
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void release_fence(void) {
+#ifdef __riscv
+    __asm__ volatile("fence rw, w" ::: "memory");
+#else
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+bool ringbuf_init(ringbuf_t *rb, void *storage, unsigned int slot_size, unsigned int capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    rb->slots = storage;
+    rb->slot_size = slot_size;
+    rb->mask = capacity - 1;
+    rb->head = 0;
+    rb->tail = 0;
+    return true;
+}
+
+unsigned int ringbuf_capacity(const ringbuf_t *rb) {
+    return rb->mask + 1;
+}
+
+unsigned int ringbuf_count(const ringbuf_t *rb) {
+    return rb->head - rb->tail;
+}
+
+unsigned int ringbuf_space(const ringbuf_t *rb) {
+    return rb->mask + 1 - (rb->head - rb->tail);
+}
+
+void *ringbuf_reserve(ringbuf_t *rb) {
+    unsigned int head = rb->head;
+    if (head - rb->tail > rb->mask) {
+        return NULL;
+    }
+    // the consumer is done with the slot before we write it
+    acquire_fence();
+    return rb->slots + (head & rb->mask) * rb->slot_size;
+}
+
+void ringbuf_commit(ringbuf_t *rb) {
+    release_fence();
+    rb->head = rb->head + 1;
+}
+
+void *ringbuf_peek(ringbuf_t *rb) {
+    unsigned int tail = rb->tail;
+    if (tail == rb->head) {
+        return NULL;
+    }
+    // see the slot contents the producer wrote before its commit
+    acquire_fence();
+    return rb->slots + (tail & rb->mask) * rb->slot_size;
+}
+
+void ringbuf_release(ringbuf_t *rb) {
+    release_fence();
+    rb->tail = rb->tail + 1;
+}
+
+bool ringbuf_push(ringbuf_t *rb, const void *msg) {
+    void *slot = ringbuf_reserve(rb);
+    if (!slot) {
+        return false;
+    }
+    memcpy(slot, msg, rb->slot_size);
+    ringbuf_commit(rb);
+    return true;
+}
+
+bool ringbuf_pop(ringbuf_t *rb, void *msg) {
+    void *slot = ringbuf_peek(rb);
+    if (!slot) {
+        return false;
+    }
+    memcpy(msg, slot, rb->slot_size);
+    ringbuf_release(rb);
+    return true;
+}
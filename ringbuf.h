@@ -0,0 +1,66 @@
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single-producer/single-consumer ring of fixed-size slots, for
+ * handing messages or whole sample blocks from interrupt context to the
+ * main loop (or back). One side only ever calls the producer functions and
+ * the other only the consumer functions; neither disables interrupts.
+ *
+ * The capacity is a power of two and the head and tail are free-running
+ * counters masked into the slot array, so all `capacity` slots are usable
+ * and full and empty are told apart without a spare slot. The producer
+ * publishes a slot with a release fence before moving the head; the
+ * consumer reads the head with an acquire fence before touching the slot,
+ * and hands the slot back the same way through the tail.
+ *
+ * Besides copying push/pop, reserve/commit and peek/release give direct
+ * access to the slot memory, so a producer can fill (or point a DMA
+ * period at) a slot in place and the consumer can process it there.
+ */
+
+typedef struct {
+    uint8_t *slots;             // capacity * slot_size bytes
+    unsigned int slot_size;     // bytes per slot
+    unsigned int mask;          // capacity - 1
+    volatile unsigned int head; // slots ever committed, written by the producer
+    volatile unsigned int tail; // slots ever released, written by the consumer
+} ringbuf_t;
+
+// Static initializer, for rings that exist from boot (capacity a power of two)
+#define RINGBUF_INIT(storage, size, capacity) \
+    { .slots = (uint8_t *)(storage), .slot_size = (size), .mask = (capacity) - 1 }
+
+/*
+ * Set up a ring over `storage` (capacity * slot_size bytes, aligned for
+ * whatever the slots hold).
+ *
+ * @return false if capacity is not a power of two
+ */
+bool ringbuf_init(ringbuf_t *rb, void *storage, unsigned int slot_size, unsigned int capacity);
+
+unsigned int ringbuf_capacity(const ringbuf_t *rb);
+// Slots holding data: the consumer can pop at least this many; for the
+// producer it is an upper bound, as the consumer may pop meanwhile
+unsigned int ringbuf_count(const ringbuf_t *rb);
+// Free slots: the producer can push at least this many; for the consumer
+// it is an upper bound, as the producer may push meanwhile
+unsigned int ringbuf_space(const ringbuf_t *rb);
+
+// Producer: copy `slot_size` bytes in; false if the ring is full
+bool ringbuf_push(ringbuf_t *rb, const void *msg);
+// Consumer: copy the oldest slot out; false if the ring is empty
+bool ringbuf_pop(ringbuf_t *rb, void *msg);
+
+// Producer, zero-copy: the next free slot (NULL if full), published by commit
+void *ringbuf_reserve(ringbuf_t *rb);
+void ringbuf_commit(ringbuf_t *rb);
+
+// Consumer, zero-copy: the oldest slot (NULL if empty), handed back by release
+void *ringbuf_peek(ringbuf_t *rb);
+void ringbuf_release(ringbuf_t *rb);
+
+#endif
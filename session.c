@@ -0,0 +1,56 @@
+/* File: session.c
+ * ---------------
+ *  Back-to-back takes on buffers allocated once
+ */
+#include "session.h"
+#include "arena.h"
+#include "strings.h"
+
+// Take edges that are muted: the mic settling at the start, the DMA tail at the end
+#define INTRO_MUTE_FRAMES 11000
+#define OUTRO_MUTE_FRAMES 7999
+
+static struct {
+    effect_chain_t *chain;
+    uint32_t *words;            // capture buffer, max_frames FIFO words
+    unsigned int max_frames;
+    int rate;
+    audio_buffer_t take;
+    unsigned int takes;
+} module;
+
+void session_init(effect_chain_t *chain, int rate, int max_seconds) {
+    module.chain = chain;
+    module.rate = rate;
+    module.max_frames = rate * max_seconds;
+    module.words = arena_alloc(&audio_arena, module.max_frames * sizeof(uint32_t));
+    module.takes = 0;
+}
+
+audio_buffer_t *session_begin_take(int seconds) {
+    unsigned int frames = seconds * module.rate;
+    if (frames > module.max_frames) {
+        frames = module.max_frames;
+    }
+    audio_buffer_wrap(&module.take, module.words, AUDIO_FORMAT_WORD32, 1, true, module.rate, frames);
+    return &module.take;
+}
+
+void session_process_take(void) {
+    audio_buffer_t *take = &module.take;
+    uint32_t *words = take->data;
+
+    effect_chain_reset(module.chain);
+    effect_chain_process_buffer(module.chain, take);
+
+    // make intro & outro clipping less awful (still not great)
+    unsigned int intro = take->frames < INTRO_MUTE_FRAMES ? take->frames : INTRO_MUTE_FRAMES;
+    memset(words, 0, intro * sizeof(uint32_t));
+    unsigned int outro = take->frames - intro < OUTRO_MUTE_FRAMES ? take->frames - intro : OUTRO_MUTE_FRAMES;
+    memset(words + take->frames - outro, 0, outro * sizeof(uint32_t));
+    module.takes++;
+}
+
+unsigned int session_take_count(void) {
+    return module.takes;
+}
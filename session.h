@@ -0,0 +1,25 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "audio_buffer.h"
+#include "effects.h"
+
+/*
+ * Recording session: any number of record -> process -> playback takes
+ * in a row, without a reboot. The capture buffer is allocated once from
+ * the audio arena, at the longest recording length, and every take
+ * reuses it, so heap use stays flat no matter how many takes are made
+ * (tools/session_soak checks this on the host).
+ */
+
+void session_init(effect_chain_t *chain, int rate, int max_seconds);
+
+// The shared buffer, sized for a take of `seconds` (clamped to max_seconds)
+audio_buffer_t *session_begin_take(int seconds);
+
+// Reset the chain, run it over the captured take in place and mute the edges
+void session_process_take(void);
+
+unsigned int session_take_count(void);
+
+#endif
@@ -0,0 +1,178 @@
+/* File: stream.c
+ * --------------
+ *  Full-duplex capture -> process -> playback engine
+ */
+#include "stream.h"
+#include "audio.h"
+#include "dma.h"
+#include "i2s.h"
+#include "strings.h"
+
+static struct {
+    const stream_backend_t *backend;
+    stream_block_fn_t fn;
+    void *aux;
+
+    uint32_t capture[STREAM_CAPTURE_PERIODS][STREAM_PERIOD_FRAMES];  // capture ring
+    uint32_t playback[STREAM_NUM_PERIODS][STREAM_PERIOD_FRAMES];     // playback ring
+
+    volatile unsigned int captured;  // periods the capture ring has filled
+    volatile unsigned int played;    // periods the playback ring has sent
+    unsigned int processed;          // captured periods run through fn
+    bool in_irq;                     // process from stream_period_captured
+    bool running;                    // backend started and not yet stopped
+
+    stream_stats_t stats;
+} module;
+
+// I2S2/DMAC backend: two circular rings, both clocked by the same I2S frame
+
+static dma_ring_t rx_ring, tx_ring;
+
+static void rx_period(int period, void *aux) {
+    stream_period_captured();
+}
+
+static void tx_period(int period, void *aux) {
+    stream_period_played();
+}
+
+static bool i2s_backend_start(uint32_t *capture, int capture_periods, uint32_t *playback, int playback_periods,
+                              unsigned int period_bytes) {
+    volatile I2S *i2s2 = (I2S *)I2S_2_BASE;
+    int rx_channel = dma_channel_request();
+    int tx_channel = dma_channel_request();
+    bool ok = rx_channel >= 0 && tx_channel >= 0 &&
+              dma_ring_init(&rx_ring, rx_channel, DMA_FROM_DEVICE, DMA_DRQ_I2S2, &i2s2->regs.rxfifo, capture,
+                            capture_periods, period_bytes, rx_period, NULL);
+    if (ok && !dma_ring_init(&tx_ring, tx_channel, DMA_TO_DEVICE, DMA_DRQ_I2S2, &i2s2->regs.txfifo, playback,
+                             playback_periods, period_bytes, tx_period, NULL)) {
+        dma_ring_release(&rx_ring);
+        ok = false;
+    }
+    if (!ok) {
+        // give back whatever was taken (dma_channel_release ignores -1)
+        dma_channel_release(rx_channel);
+        dma_channel_release(tx_channel);
+        return false;
+    }
+    i2s_duplex_start();
+    dma_ring_start(&tx_ring);
+    dma_ring_start(&rx_ring);
+    return true;
+}
+
+static void i2s_backend_stop(void) {
+    dma_ring_release(&rx_ring);
+    dma_ring_release(&tx_ring);
+    dma_channel_release(rx_ring.channel);
+    dma_channel_release(tx_ring.channel);
+}
+
+static void i2s_backend_service(void) {
+    // with DMA interrupts running the tick already delivers periods
+    if (!dma_interrupts_enabled()) {
+        dma_ring_service();
+    }
+}
+
+static const stream_backend_t i2s_backend = {
+    .start = i2s_backend_start,
+    .stop = i2s_backend_stop,
+    .service = i2s_backend_service,
+};
+
+void stream_init(const stream_backend_t *backend, stream_block_fn_t fn, void *aux) {
+    memset(&module, 0, sizeof(module));
+    module.backend = backend ? backend : &i2s_backend;
+    module.fn = fn;
+    module.aux = aux;
+}
+
+bool stream_start(void) {
+    if (module.running) {
+        return true;
+    }
+    // the playback ring starts out silent and runs in lockstep with capture
+    module.running = module.backend->start(module.capture[0], STREAM_CAPTURE_PERIODS, module.playback[0],
+                                           STREAM_NUM_PERIODS, sizeof(module.capture[0]));
+    return module.running;
+}
+
+void stream_stop(void) {
+    if (module.running) {
+        module.backend->stop();
+        module.running = false;
+    }
+}
+
+static int process_captured(void);
+
+void stream_period_captured(void) {
+    module.captured++;
+    if (module.in_irq) {
+        process_captured();
+    }
+}
+
+void stream_period_played(void) {
+    // silence the slot just sent, so a period that is not refilled in time
+    // plays as a gap rather than as stale audio
+    memset(module.playback[module.played % STREAM_NUM_PERIODS], 0, sizeof(module.playback[0]));
+    module.played++;
+}
+
+// Move a captured period into its playback slot and let the block
+// callback process it there, at the full 32-bit capture precision
+static void process_period(const uint32_t *in, uint32_t *out) {
+    memcpy(out, in, STREAM_PERIOD_FRAMES * sizeof(uint32_t));
+    if (module.fn) {
+        module.fn(out, STREAM_PERIOD_FRAMES, module.aux);
+    }
+}
+
+void stream_process_in_irq(bool enable) {
+    module.in_irq = enable;
+}
+
+int stream_poll(void) {
+    if (module.backend->service) {
+        module.backend->service();
+    }
+    return module.in_irq ? 0 : process_captured();
+}
+
+// Run every captured period not yet processed into its playback slot
+static int process_captured(void) {
+    unsigned int captured = module.captured;
+    if (captured - module.processed >= STREAM_CAPTURE_PERIODS) {
+        // the capture ring lapped us: only the newest period is still intact
+        module.stats.overruns += captured - module.processed - 1;
+        module.processed = captured - 1;
+    }
+
+    int processed = 0;
+    while (module.processed != captured) {
+        // capture period p plays back during playback period p + STREAM_PREFILL
+        unsigned int p = module.processed++;
+        if (p + STREAM_PREFILL <= module.played) {
+            module.stats.underruns++;   // its slot is already playing or gone
+        } else {
+            process_period(module.capture[p % STREAM_CAPTURE_PERIODS],
+                           module.playback[(p + STREAM_PREFILL) % STREAM_NUM_PERIODS]);
+        }
+        module.stats.periods++;
+        processed++;
+    }
+    return processed;
+}
+
+unsigned int stream_latency_us(void) {
+    // a sample captured at the start of period p leaves the DAC at the start of p + STREAM_PREFILL
+    unsigned int frames = STREAM_PREFILL * STREAM_PERIOD_FRAMES;
+    return (unsigned int)((unsigned long)frames * 1000000 / STREAM_SAMPLE_RATE);
+}
+
+stream_stats_t stream_get_stats(void) {
+    return module.stats;
+}
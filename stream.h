@@ -0,0 +1,88 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Full-duplex streaming engine.
+ *
+ * Mic capture and DAC output run at the same time as circular DMA rings
+ * that never stop. Each captured period is copied into the playback ring
+ * STREAM_PREFILL periods ahead of the DAC and handed to the block
+ * callback there as 32-bit left-justified FIFO words, to be processed in
+ * place (e.g. by effect_chain_process_words). Input-to-output latency is
+ * a few periods instead of a whole recording.
+ */
+
+#define STREAM_SAMPLE_RATE 44100
+#define STREAM_PERIOD_FRAMES 128
+#define STREAM_CAPTURE_PERIODS 2
+#define STREAM_NUM_PERIODS 4
+// how far ahead of the DAC a processed period is written (absorbs polling jitter)
+#define STREAM_PREFILL 2
+
+typedef void (*stream_block_fn_t)(uint32_t *words, int nframes, void *aux);
+
+/*
+ * Runs the capture and playback rings on the hardware. Buffers hold one
+ * 32-bit left-justified FIFO word per frame. The backend reports each
+ * finished period with stream_period_captured() / stream_period_played().
+ * Passing NULL to stream_init selects the I2S2/DMAC backend; a host build
+ * can pass its own (e.g. one that reads and writes WAV files) to run the
+ * engine off-target. start returns false, with nothing left running or
+ * held, if the backend cannot get what it needs (e.g. DMA channels).
+ */
+typedef struct {
+    bool (*start)(uint32_t *capture, int capture_periods, uint32_t *playback, int playback_periods,
+                  unsigned int period_bytes);
+    void (*stop)(void);
+    void (*service)(void);  // deliver finished periods, called from stream_poll
+} stream_backend_t;
+
+typedef struct {
+    unsigned int periods;    // periods captured and processed
+    unsigned int underruns;  // period processed too late for its playback slot
+    unsigned int overruns;   // captured period overwritten before it was processed
+} stream_stats_t;
+
+void stream_init(const stream_backend_t *backend, stream_block_fn_t fn, void *aux);
+// false if the backend could not start (nothing is running then)
+bool stream_start(void);
+// stops the backend if it is running
+void stream_stop(void);
+
+// Backend notifications, one per finished period (safe from interrupt context)
+void stream_period_captured(void);
+void stream_period_played(void);
+
+/*
+ * Service the engine: process any captured periods into the playback
+ * ring. Call this from the main loop at least once per period.
+ *
+ * @return the number of periods processed by this call
+ */
+int stream_poll(void);
+
+/*
+ * Process each period as soon as the backend reports it captured (from
+ * the DMA interrupt, with dma_interrupts_init), instead of in stream_poll.
+ * The main loop is then free to spend longer than a period on other work,
+ * such as a redraw, without an underrun. The block callback runs in
+ * interrupt context and must not share unguarded state with the main
+ * loop (hand it settings through a ringbuf.h queue). Set before
+ * stream_start; stream_init turns it off.
+ */
+void stream_process_in_irq(bool enable);
+
+unsigned int stream_latency_us(void);
+
+/*
+ * Counts since stream_init. With the I2S2/DMAC backend and DMA interrupts
+ * off, a stream_poll more than a whole ring late is seen as exactly one
+ * lap (dma_ring_service), so the overruns and underruns it causes are
+ * counted, but periods beyond that lap are not.
+ */
+stream_stats_t stream_get_stats(void);
+
+#endif
@@ -0,0 +1,140 @@
+/* File: compressor_bench.c
+ * ------------------------
+ *  Host benchmark of the compressor stage on 44.1 kHz blocks.
+ *
+ *  A tone stepping between quiet, loud and full scale (so attack, release
+ *  and the knee all run) is pushed through compressor_process one
+ *  128-frame block at a time, the stream engine's period. The mean and
+ *  worst time per block (each block's fastest of a few passes) are
+ *  reported against the block's real-time deadline and against
+ *  COMPRESSOR_BUDGET_PERCENT. The output is also checked to be untouched
+ *  below the knee and reduced above it, so the timed path is the real one.
+ *  Build and run with `make compressor_bench`.
+ *
+ *  The host is many times faster than the D1's in-order core, so treat
+ *  the percentages as a lower bound; the profile from
+ *  effect_chain_report() on the board is the real number.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "compressor.h"
+
+#define BLOCK 128
+#define SECONDS 10
+#define NBLOCKS (EFFECT_SAMPLE_RATE * SECONDS / BLOCK)
+#define PASSES 5
+#define STEP_BLOCKS (EFFECT_SAMPLE_RATE / 2 / BLOCK)    // level changes every half second
+
+void *host_malloc(size_t nbytes) {
+    return malloc(nbytes);
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+static sample_t input[NBLOCKS][BLOCK], output[NBLOCKS][BLOCK];
+
+// A 441 Hz square wave (a whole number of cycles per 100 frames) at
+// -30, -6 and 0 dBFS in turn
+static const sample_t levels[] = {SAMPLE_ONE / 32, SAMPLE_ONE / 2, SAMPLE_ONE - 1};
+static const int levels_db[] = {-30, -6, 0};
+
+static void make_input(void) {
+    for (int b = 0; b < NBLOCKS; b++) {
+        sample_t level = levels[b / STEP_BLOCKS % 3];
+        for (int i = 0; i < BLOCK; i++) {
+            int frame = b * BLOCK + i;
+            input[b][i] = frame % 100 < 50 ? level : -level;
+        }
+    }
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static sample_t peak(const sample_t *block) {
+    sample_t max = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        sample_t a = block[i] < 0 ? -block[i] : block[i];
+        if (a > max) max = a;
+    }
+    return max;
+}
+
+// Blocks below the knee pass through at unity gain, ones above it come out lower
+static void check_gain(const char *name, const compressor_params_t *params) {
+    for (int b = STEP_BLOCKS; b < NBLOCKS; b++) {
+        int phase = b % STEP_BLOCKS;
+        if (phase < STEP_BLOCKS * 3 / 4) {
+            continue;   // let the envelope settle after each step (release is slow)
+        }
+        int db = levels_db[b / STEP_BLOCKS % 3];
+        sample_t in = peak(input[b]), out = peak(output[b]);
+        bool bad = false;
+        if (2 * (db - params->threshold_db) < -params->knee_db) {
+            bad = out < in - in / 100 || out > in + in / 100;
+        } else if (2 * (db - params->threshold_db) > params->knee_db) {
+            bad = out >= in;
+        }
+        if (bad) {
+            fprintf(stderr, "compressor_bench: %s block %d: peak %d -> %d\n", name, b, in, out);
+            exit(1);
+        }
+    }
+}
+
+static void bench(const char *name, compressor_params_t params) {
+    effect_t *fx = effect_compressor_new(&params);
+    double deadline = BLOCK * 1e6 / EFFECT_SAMPLE_RATE;
+
+    // each block's time is its fastest of PASSES runs over the same audio,
+    // so the worst block reflects the data rather than host preemption
+    static double block_us[NBLOCKS];
+    for (int pass = 0; pass < PASSES; pass++) {
+        fx->reset(fx);
+        for (int b = 0; b < NBLOCKS; b++) {
+            for (int i = 0; i < BLOCK; i++) {
+                output[b][i] = input[b][i];
+            }
+            double t = now_us();
+            fx->prepare(fx);
+            fx->process(fx, output[b], BLOCK);
+            t = now_us() - t;
+            if (pass == 0 || t < block_us[b]) block_us[b] = t;
+        }
+    }
+    check_gain(name, &params);
+
+    double total = 0, worst = 0;
+    for (int b = 0; b < NBLOCKS; b++) {
+        total += block_us[b];
+        if (block_us[b] > worst) worst = block_us[b];
+    }
+    double mean = total / NBLOCKS;
+    printf("  %-18s %6.2f us mean, %6.2f us worst  (%.3f%% / %.3f%% of %.0f us, budget %d%%)\n",
+           name, mean, worst, 100 * mean / deadline, 100 * worst / deadline, deadline,
+           COMPRESSOR_BUDGET_PERCENT);
+}
+
+int main(void) {
+    make_input();
+    printf("compressor_bench: %d blocks of %d frames at %d Hz, per block:\n", NBLOCKS, BLOCK,
+           EFFECT_SAMPLE_RATE);
+    bench("peak, hard knee", (compressor_params_t){.threshold_db = -12, .ratio = 4, .knee_db = 0,
+                                                   .attack_ms = 5, .release_ms = 80});
+    bench("peak, 6 dB knee", (compressor_params_t){.threshold_db = -12, .ratio = 4, .knee_db = 6,
+                                                   .attack_ms = 5, .release_ms = 80});
+    bench("rms, 6 dB knee", (compressor_params_t){.threshold_db = -12, .ratio = 4, .knee_db = 6,
+                                                  .attack_ms = 5, .release_ms = 80,
+                                                  .detector = COMPRESSOR_RMS});
+    bench("rms, limiter", (compressor_params_t){.threshold_db = -3, .ratio = 20, .knee_db = 0,
+                                                .attack_ms = 1, .release_ms = 50,
+                                                .detector = COMPRESSOR_RMS});
+    return 0;
+}
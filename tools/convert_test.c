@@ -0,0 +1,241 @@
+/* File: convert_test.c
+ * --------------------
+ *  Host test and benchmark of the format conversion kernels in
+ *  audio_buffer.c.
+ *
+ *  Every kernel is checked against a plain one-sample-at-a-time reference
+ *  on random input that includes both extremes, for every length up to
+ *  past the unroll (so each tail path runs) and at a period-sized length.
+ *  Conversions audio_buffer_convert() allows in place are also run with
+ *  input and output on the same storage, through the kernel and through
+ *  audio_buffer_convert(). Then each kernel is timed against its
+ *  reference. Build and run with `make convert_test`.
+ *
+ *  Built -Og like the board, so neither side is vectorized (rv64im has
+ *  no vector unit); expect the ratios, not the times, to carry over.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_buffer.h"
+
+#define MAX_N 1024
+#define REPS 20000
+
+void *host_malloc(size_t nbytes) {
+    return malloc(nbytes);
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+// References: one sample per iteration, in the order of the definition
+
+static void ref_word32_to_s16(const uint32_t *in, int16_t *out, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) out[i] = (int16_t)(in[i] >> 16);
+}
+
+static void ref_s16_to_word32(const int16_t *in, uint32_t *out, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) out[i] = (uint32_t)(uint16_t)in[i] << 16;
+}
+
+static void ref_s16_to_q24(const int16_t *in, int32_t *out, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) out[i] = in[i] * 512;
+}
+
+static void ref_word32_to_q24(const uint32_t *in, int32_t *out, unsigned int n) {
+    // the top 25 bits, sign extended: full scale is +-(1 << 24)
+    for (unsigned int i = 0; i < n; i++) out[i] = (int32_t)in[i] >> 7;
+}
+
+static void ref_interleave_s16(const int16_t *left, const int16_t *right, int16_t *out, unsigned int frames) {
+    for (unsigned int i = 0; i < frames; i++) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static void ref_deinterleave_s16(const int16_t *in, int16_t *left, int16_t *right, unsigned int frames) {
+    for (unsigned int i = 0; i < frames; i++) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+static uint32_t seed = 1;
+
+static uint32_t rand32(void) {
+    seed = seed * 1664525 + 1013904223;
+    return seed ^ (seed >> 15);
+}
+
+static void fill_random(void *buf, size_t bytes) {
+    uint8_t *p = buf;
+    for (size_t i = 0; i < bytes; i++) p[i] = rand32() >> 24;
+}
+
+// Random samples with both extremes planted near each end
+static void fill_s16(int16_t *buf, unsigned int n) {
+    fill_random(buf, n * sizeof(int16_t));
+    if (n > 0) buf[0] = INT16_MIN;
+    if (n > 1) buf[n - 1] = INT16_MAX;
+    if (n > 2) buf[1] = -1;
+}
+
+static void fill_word32(uint32_t *buf, unsigned int n) {
+    fill_random(buf, n * sizeof(uint32_t));
+    if (n > 0) buf[0] = 0x80000000;
+    if (n > 1) buf[n - 1] = 0x7fffffff;
+    if (n > 2) buf[1] = 0xffffffff;
+}
+
+// Storage shared by in-place runs, aligned for the widest format
+static union {
+    uint32_t words[MAX_N];
+    int32_t q24[MAX_N];
+    int16_t s16[2 * MAX_N];
+} shared;
+
+static void check_kernels(unsigned int n) {
+    static int16_t s16[2 * MAX_N], got16[2 * MAX_N], want16[2 * MAX_N], right[MAX_N], want_right[MAX_N];
+    static uint32_t words[MAX_N], got32[MAX_N], want32[MAX_N];
+    fill_s16(s16, 2 * n);
+    fill_word32(words, n);
+
+    audio_convert_word32_to_s16(words, got16, n);
+    ref_word32_to_s16(words, want16, n);
+    assert(!memcmp(got16, want16, n * sizeof(int16_t)));
+    memcpy(shared.words, words, n * sizeof(uint32_t));
+    audio_convert_word32_to_s16(shared.words, shared.s16, n);
+    assert(!memcmp(shared.s16, want16, n * sizeof(int16_t)));
+
+    audio_convert_s16_to_word32(s16, got32, n);
+    ref_s16_to_word32(s16, want32, n);
+    assert(!memcmp(got32, want32, n * sizeof(uint32_t)));
+    memcpy(shared.s16, s16, n * sizeof(int16_t));
+    audio_convert_s16_to_word32(shared.s16, shared.words, n);
+    assert(!memcmp(shared.words, want32, n * sizeof(uint32_t)));
+
+    audio_convert_s16_to_q24(s16, (int32_t *)got32, n);
+    ref_s16_to_q24(s16, (int32_t *)want32, n);
+    assert(!memcmp(got32, want32, n * sizeof(int32_t)));
+    memcpy(shared.s16, s16, n * sizeof(int16_t));
+    audio_convert_s16_to_q24(shared.s16, shared.q24, n);
+    assert(!memcmp(shared.q24, want32, n * sizeof(int32_t)));
+
+    audio_convert_word32_to_q24(words, (int32_t *)got32, n);
+    ref_word32_to_q24(words, (int32_t *)want32, n);
+    assert(!memcmp(got32, want32, n * sizeof(int32_t)));
+    memcpy(shared.words, words, n * sizeof(uint32_t));
+    audio_convert_word32_to_q24(shared.words, shared.q24, n);
+    assert(!memcmp(shared.q24, want32, n * sizeof(int32_t)));
+
+    // (de)interleaving needs separate storage
+    audio_interleave_s16(s16, s16 + n, got16, n);
+    ref_interleave_s16(s16, s16 + n, want16, n);
+    assert(!memcmp(got16, want16, 2 * n * sizeof(int16_t)));
+    audio_deinterleave_s16(s16, got16, right, n);
+    ref_deinterleave_s16(s16, want16, want_right, n);
+    assert(!memcmp(got16, want16, n * sizeof(int16_t)));
+    assert(!memcmp(right, want_right, n * sizeof(int16_t)));
+}
+
+// The same conversions through audio_buffer_convert, in place where it allows
+static void check_buffers(unsigned int n) {
+    static int16_t s16[2 * MAX_N];
+    static uint32_t want[2 * MAX_N];
+    fill_s16(s16, 2 * n);
+    ref_s16_to_word32(s16, want, 2 * n);
+
+    // stereo interleaved s16 -> word32 on the same storage
+    static union {
+        uint32_t words[2 * MAX_N];
+        int16_t s16[4 * MAX_N];
+    } stereo;
+    memcpy(stereo.s16, s16, 2 * n * sizeof(int16_t));
+    audio_buffer_t src, dst;
+    audio_buffer_wrap(&src, stereo.s16, AUDIO_FORMAT_S16, 2, true, 44100, n);
+    audio_buffer_wrap(&dst, stereo.words, AUDIO_FORMAT_WORD32, 2, true, 0, n);
+    assert(audio_buffer_convert(&src, &dst));
+    assert(dst.frames == n && dst.rate == 44100);
+    assert(!memcmp(stereo.words, want, 2 * n * sizeof(uint32_t)));
+
+    // and back down
+    audio_buffer_wrap(&src, stereo.words, AUDIO_FORMAT_WORD32, 2, true, 44100, n);
+    audio_buffer_wrap(&dst, stereo.s16, AUDIO_FORMAT_S16, 2, true, 0, n);
+    assert(audio_buffer_convert(&src, &dst));
+    assert(!memcmp(stereo.s16, s16, 2 * n * sizeof(int16_t)));
+
+    // interleaving on the same storage is refused, not corrupted
+    audio_buffer_wrap(&src, stereo.s16, AUDIO_FORMAT_S16, 2, true, 44100, n);
+    audio_buffer_wrap(&dst, stereo.s16, AUDIO_FORMAT_S16, 2, false, 0, n);
+    assert(!audio_buffer_convert(&src, &dst));
+    assert(!memcmp(stereo.s16, s16, 2 * n * sizeof(int16_t)));
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int16_t bench_s16[2 * MAX_N];
+static uint32_t bench_words[MAX_N];
+static int32_t bench_q24[MAX_N];
+
+// Keep the compiler from dropping repeated conversions of the same buffers
+static void touch(void) {
+    __asm__ volatile("" : : "r"(bench_s16), "r"(bench_words), "r"(bench_q24) : "memory");
+}
+
+#define BENCH(name, ref_call, kernel_call)                                                    \
+    do {                                                                                      \
+        double t = now_us();                                                                  \
+        for (int r = 0; r < REPS; r++) {                                                      \
+            ref_call;                                                                         \
+            touch();                                                                          \
+        }                                                                                     \
+        double t_ref = (now_us() - t) * 1000 / REPS / MAX_N;                                 \
+        t = now_us();                                                                         \
+        for (int r = 0; r < REPS; r++) {                                                      \
+            kernel_call;                                                                      \
+            touch();                                                                          \
+        }                                                                                     \
+        double t_kernel = (now_us() - t) * 1000 / REPS / MAX_N;                              \
+        printf("  %-16s %6.3f ns -> %6.3f ns per sample  (%.1fx)\n", name, t_ref, t_kernel, \
+               t_ref / t_kernel);                                                             \
+    } while (0)
+
+int main(void) {
+    for (unsigned int n = 0; n <= 16; n++) {
+        check_kernels(n);
+        check_buffers(n);
+    }
+    for (int i = 0; i < 100; i++) {
+        unsigned int n = MAX_N - rand32() % 8;
+        check_kernels(n);
+        check_buffers(n);
+    }
+    printf("convert_test: kernels match the references, in place too\n");
+
+    fill_s16(bench_s16, 2 * MAX_N);
+    fill_word32(bench_words, MAX_N);
+    printf("convert_test: %d samples, reference -> kernel:\n", MAX_N);
+    BENCH("word32 -> s16", ref_word32_to_s16(bench_words, bench_s16, MAX_N),
+          audio_convert_word32_to_s16(bench_words, bench_s16, MAX_N));
+    BENCH("s16 -> word32", ref_s16_to_word32(bench_s16, bench_words, MAX_N),
+          audio_convert_s16_to_word32(bench_s16, bench_words, MAX_N));
+    BENCH("s16 -> q24", ref_s16_to_q24(bench_s16, bench_q24, MAX_N),
+          audio_convert_s16_to_q24(bench_s16, bench_q24, MAX_N));
+    BENCH("word32 -> q24", ref_word32_to_q24(bench_words, bench_q24, MAX_N),
+          audio_convert_word32_to_q24(bench_words, bench_q24, MAX_N));
+    BENCH("interleave", ref_interleave_s16(bench_s16, bench_s16 + MAX_N / 2, (int16_t *)bench_q24, MAX_N / 2),
+          audio_interleave_s16(bench_s16, bench_s16 + MAX_N / 2, (int16_t *)bench_q24, MAX_N / 2));
+    BENCH("deinterleave", ref_deinterleave_s16((int16_t *)bench_q24, bench_s16, bench_s16 + MAX_N / 2, MAX_N / 2),
+          audio_deinterleave_s16((int16_t *)bench_q24, bench_s16, bench_s16 + MAX_N / 2, MAX_N / 2));
+    return 0;
+}
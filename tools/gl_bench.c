@@ -0,0 +1,567 @@
+/* File: gl_bench.c
+ * ----------------
+ *  Host microbenchmark of gl.c on an in-memory 1280x720 framebuffer.
+ *  Each fast path is checked against the original code, then both are
+ *  timed, and the damage each primitive reports (fb_extra.h) is checked
+ *  to cover every pixel it changes. Build and run with `make gl_bench`.
+ *
+ *  Text from the glyph atlas must match the original per-pixel text
+ *  pixel for pixel, clipped at every edge.
+ *
+ *  Fills must match pixel for pixel. Fixed-point lines must be within 1
+ *  per channel of the original float lines up to 100 pixels long (the
+ *  UI's sloped lines are shorter, and its straight ones cannot drift).
+ *  Past that, the float code's running `intery += gradient` drifts by
+ *  more than a level, so long lines are checked instead against the same
+ *  algorithm evaluated exactly in double.
+ *  The host has an FPU, so the line speedup on the board, where every
+ *  float op is a library call, is larger than shown here.
+ */
+#include "../gl.c"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define REPS 50
+
+// In-memory framebuffer (single buffered), 8-byte aligned like the arena's
+static uint64_t framebuffer[WIDTH * HEIGHT / 2];
+static int fb_width, fb_height;
+
+void fb_init(int width, int height, fb_mode_t mode) {
+    fb_width = width;
+    fb_height = height;
+}
+int fb_get_width(void) { return fb_width; }
+int fb_get_height(void) { return fb_height; }
+int fb_get_depth(void) { return 4; }
+void *fb_get_draw_buffer(void) { return framebuffer; }
+
+// Damage gl.c reports, as one clipped bounding box like fb.c keeps
+static fb_rect_t damage;
+
+void fb_damage(int x, int y, int w, int h) {
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = x + w > fb_width ? fb_width : x + w;
+    int y1 = y + h > fb_height ? fb_height : y + h;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    if (damage.w > 0 && damage.h > 0) {
+        x0 = damage.x < x0 ? damage.x : x0;
+        y0 = damage.y < y0 ? damage.y : y0;
+        x1 = damage.x + damage.w > x1 ? damage.x + damage.w : x1;
+        y1 = damage.y + damage.h > y1 ? damage.y + damage.h : y1;
+    }
+    damage = (fb_rect_t){ .x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0 };
+}
+fb_rect_t fb_get_damage(void) { return damage; }
+void fb_swap_buffer(void) { damage = (fb_rect_t){0}; }
+
+// 14x16 like the board's font: a different pattern per character, so a
+// glyph drawn from the wrong slot or row shows up
+#define GLYPH_W 14
+#define GLYPH_H 16
+int font_get_glyph_height(void) { return GLYPH_H; }
+int font_get_glyph_width(void) { return GLYPH_W; }
+int font_get_glyph_size(void) { return GLYPH_W * GLYPH_H; }
+bool font_get_glyph(char ch, unsigned char buf[], size_t buflen) {
+    if (ch <= ' ' || ch > '~') {
+        return false;
+    }
+    for (int i = 0; i < GLYPH_W * GLYPH_H; i++) {
+        int x = i % GLYPH_W, y = i / GLYPH_W;
+        buf[i] = (x > 0 && x < GLYPH_W - 1 && y > 1 && y < GLYPH_H - 2 &&
+                  ((x * 7 + y * 3 + ch) % 5 < 2)) ? 0xFF : 0;
+    }
+    return true;
+}
+
+// The original code, as the reference
+
+static void ref_draw_pixel(int x, int y, color_t c) {
+    if (x < 0 || x >= gl_width || y < 0 || y >= gl_height) {
+        return;
+    }
+    unsigned char *buffer = (unsigned char *)fb_get_draw_buffer();
+    int offset = (y * gl_width + x) * gl_depth;
+    unsigned char *pixel = (unsigned char *)&c;
+    buffer[offset] = pixel[0];
+    buffer[offset + 1] = pixel[1];
+    buffer[offset + 2] = pixel[2];
+    buffer[offset + 3] = pixel[3];
+}
+
+static void ref_clear(color_t c) {
+    int nbytes = gl_width * gl_height * gl_depth;
+    unsigned char *buffer = fb_get_draw_buffer();
+    unsigned char *pixel = (unsigned char *)&c;
+    for (int i = 0; i < nbytes; i += 4) {
+        buffer[i] = pixel[0];
+        buffer[i + 1] = pixel[1];
+        buffer[i + 2] = pixel[2];
+        buffer[i + 3] = pixel[3];
+    }
+}
+
+static void ref_draw_rect(int x, int y, int w, int h, color_t c) {
+    for (int i = 0; i < w; i++) {
+        for (int j = 0; j < h; j++) {
+            ref_draw_pixel(x + i, y + j, c);
+        }
+    }
+}
+
+static color_t ref_read_pixel(int x, int y) {
+    if (x < 0 || x >= gl_width || y < 0 || y >= gl_height) {
+        return 0;
+    }
+    unsigned char *buffer = (unsigned char *)fb_get_draw_buffer();
+    int offset = (y * gl_width + x) * gl_depth;
+    unsigned char pixel[4];
+    pixel[0] = buffer[offset];
+    pixel[1] = buffer[offset + 1];
+    pixel[2] = buffer[offset + 2];
+    pixel[3] = buffer[offset + 3];
+    return *(color_t *)pixel;
+}
+
+static void ref_draw_char(int x, int y, char ch, color_t c) {
+    unsigned char glyph[GLYPH_W * GLYPH_H];
+    if (!font_get_glyph(ch, glyph, sizeof(glyph))) {
+        return;
+    }
+    for (int i = 0; i < GLYPH_H; i++) {
+        for (int j = 0; j < GLYPH_W; j++) {
+            if (glyph[i * GLYPH_W + j] == 0xFF) {
+                ref_draw_pixel(x + j, y + i, c);
+            }
+        }
+    }
+}
+
+static void ref_draw_string(int x, int y, const char *str, color_t c) {
+    while (*str) {
+        ref_draw_char(x, y, *str++, c);
+        x += GLYPH_W;
+    }
+}
+
+static float ref_round(float x) {
+    return x >= 0.0f ? (int)(x + 0.5f) : (int)(x - 0.5f);
+}
+
+static float ref_fmod(float x, float y) {
+    return x - (int)(x / y) * y;
+}
+
+static int ref_floor(float x) {
+    return (int)x - (x < (int)x);
+}
+
+static void ref_plot(int x, int y, float brightness, color_t c) {
+    if (x < 0 || x >= gl_get_width() || y < 0 || y >= gl_get_height()) {
+        return;
+    }
+    color_t current_color = ref_read_pixel(x, y);
+    unsigned char *current_pixel = (unsigned char *)&current_color;
+    unsigned char *new_pixel = (unsigned char *)&c;
+    unsigned char blended_pixel[4];
+    for (int i = 0; i < 4; i++) {
+        blended_pixel[i] = (unsigned char)((1 - brightness) * current_pixel[i] + brightness * new_pixel[i]);
+    }
+    color_t blended_color = *(color_t *)blended_pixel;
+    ref_draw_pixel(x, y, blended_color);
+}
+
+static void ref_draw_line(int x0, int y0, int x1, int y1, color_t c) {
+    int steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep) {
+        int temp = x0;
+        x0 = y0;
+        y0 = temp;
+        temp = x1;
+        x1 = y1;
+        y1 = temp;
+    }
+    if (x0 > x1) {
+        int temp = x0;
+        x0 = x1;
+        x1 = temp;
+        temp = y0;
+        y0 = y1;
+        y1 = temp;
+    }
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    float gradient = dy / (float)dx;
+
+    float xend = ref_round(x0);
+    float yend = y0 + gradient * (xend - x0);
+    float xgap = 1.0 - ref_fmod(x0 + 0.5, 1.0);
+    int xpxl1 = xend;
+    int ypxl1 = ref_floor(yend);
+    if (steep) {
+        ref_plot(ypxl1, xpxl1, (1.0 - ref_fmod(yend, 1.0)) * xgap, c);
+        ref_plot(ypxl1 + 1, xpxl1, ref_fmod(yend, 1.0) * xgap, c);
+    } else {
+        ref_plot(xpxl1, ypxl1, (1.0 - ref_fmod(yend, 1.0)) * xgap, c);
+        ref_plot(xpxl1, ypxl1 + 1, ref_fmod(yend, 1.0) * xgap, c);
+    }
+    float intery = yend + gradient;
+
+    xend = ref_round(x1);
+    yend = y1 + gradient * (xend - x1);
+    xgap = ref_fmod(x1 + 0.5, 1.0);
+    int xpxl2 = xend;
+    int ypxl2 = ref_floor(yend);
+    if (steep) {
+        ref_plot(ypxl2, xpxl2, (1.0 - ref_fmod(yend, 1.0)) * xgap, c);
+        ref_plot(ypxl2 + 1, xpxl2, ref_fmod(yend, 1.0) * xgap, c);
+    } else {
+        ref_plot(xpxl2, ypxl2, (1.0 - ref_fmod(yend, 1.0)) * xgap, c);
+        ref_plot(xpxl2, ypxl2 + 1, ref_fmod(yend, 1.0) * xgap, c);
+    }
+
+    if (steep) {
+        for (int x = xpxl1 + 1; x < xpxl2; x++) {
+            ref_plot(ref_floor(intery), x, 1.0 - ref_fmod(intery, 1.0), c);
+            ref_plot(ref_floor(intery) + 1, x, ref_fmod(intery, 1.0), c);
+            intery += gradient;
+        }
+    } else {
+        for (int x = xpxl1 + 1; x < xpxl2; x++) {
+            ref_plot(x, ref_floor(intery), 1.0 - ref_fmod(intery, 1.0), c);
+            ref_plot(x, ref_floor(intery) + 1, ref_fmod(intery, 1.0), c);
+            intery += gradient;
+        }
+    }
+}
+
+// Wu with each row position computed exactly in double, no running sum
+static void exact_draw_line(int x0, int y0, int x1, int y1, color_t c) {
+    int steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep) {
+        int temp = x0;
+        x0 = y0;
+        y0 = temp;
+        temp = x1;
+        x1 = y1;
+        y1 = temp;
+    }
+    if (x0 > x1) {
+        int temp = x0;
+        x0 = x1;
+        x1 = temp;
+        temp = y0;
+        y0 = y1;
+        y1 = temp;
+    }
+    double gradient = (y1 - y0) / (double)(x1 - x0);
+    if (steep) {
+        ref_plot(y0, x0, 0.5, c);
+        ref_plot(y1, x1, 0.5, c);
+    } else {
+        ref_plot(x0, y0, 0.5, c);
+        ref_plot(x1, y1, 0.5, c);
+    }
+    for (int x = x0 + 1; x < x1; x++) {
+        double intery = y0 + gradient * (x - x0);
+        int y = (int)intery - (intery < (int)intery);
+        double frac = intery - y;
+        if (steep) {
+            ref_plot(y, x, 1.0 - frac, c);
+            ref_plot(y + 1, x, frac, c);
+        } else {
+            ref_plot(x, y, 1.0 - frac, c);
+            ref_plot(x, y + 1, frac, c);
+        }
+    }
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Keep the compiler from dropping repeated fills of the same buffer
+static void touch(void) {
+    __asm__ volatile("" : : "r"(framebuffer) : "memory");
+}
+
+static uint64_t snapshot[WIDTH * HEIGHT / 2];
+
+static void check_rect(int x, int y, int w, int h) {
+    ref_clear(0xFF101010);
+    ref_draw_rect(x, y, w, h, 0xFF3366CC);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(0xFF101010);
+    gl_draw_rect(x, y, w, h, 0xFF3366CC);
+    assert(memcmp(snapshot, framebuffer, sizeof(framebuffer)) == 0);
+}
+
+// Draw over a busy background and check that every pixel that changed is
+// inside the damage gl.c reported, so a partial redraw misses nothing
+static void check_damage(void (*draw)(void)) {
+    gl_clear(0xFF303030);
+    gl_draw_rect(100, 100, 600, 300, 0xFF80C040);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    fb_swap_buffer();
+    draw();
+    const uint32_t *before = (const uint32_t *)snapshot, *after = (const uint32_t *)framebuffer;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            if (before[y * WIDTH + x] != after[y * WIDTH + x]) {
+                assert(x >= damage.x && x < damage.x + damage.w);
+                assert(y >= damage.y && y < damage.y + damage.h);
+            }
+        }
+    }
+}
+
+static void check_string(int x, int y, const char *str) {
+    ref_clear(0xFF101010);
+    ref_draw_string(x, y, str, 0xFFE0E0E0);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(0xFF101010);
+    gl_draw_string(x, y, str, 0xFFE0E0E0);
+    assert(memcmp(snapshot, framebuffer, sizeof(framebuffer)) == 0);
+}
+
+static void damage_lines(void) {
+    gl_draw_line(700, 300, 650, 390, 0xFFFF0000);   // steep, right to left
+    gl_draw_line(20, 600, 400, 580, GL_WHITE);      // shallow, rising
+}
+static void damage_clipped(void) {
+    gl_draw_line(-30, 5, 40, -20, GL_WHITE);
+    gl_draw_circle(WIDTH - 10, HEIGHT - 10, 40, GL_WHITE);
+    gl_draw_rect(WIDTH - 5, 500, 20, 20, GL_BLACK);
+}
+static void damage_text(void) {
+    gl_draw_string(90, 95, "Knob", GL_BLACK);
+    gl_draw_pixel(3, 700, GL_WHITE);
+}
+
+// Every channel of every pixel within 1 of the reference
+static int max_channel_diff(void) {
+    const uint8_t *a = (const uint8_t *)snapshot, *b = (const uint8_t *)framebuffer;
+    int worst = 0;
+    for (size_t i = 0; i < sizeof(framebuffer); i++) {
+        int d = abs(a[i] - b[i]);
+        worst = d > worst ? d : worst;
+    }
+    return worst;
+}
+
+// A random on-screen line of any slope, at most `max_len` pixels along its
+// major axis, over a two-tone background: drawn with the reference and
+// with gl_draw_line. (Lines drawn over each other blend over already
+// rounded pixels, so the bound is per line.)
+static int check_line(void (*reference)(int, int, int, int, color_t), int max_len, uint32_t *seed) {
+    int coords[4];
+    for (int k = 0; k < 4; k++) {
+        *seed = *seed * 1664525 + 1013904223;
+        coords[k] = (*seed >> 8) % (k % 2 ? HEIGHT : WIDTH);
+    }
+    for (int k = 2; k < 4; k++) {
+        *seed = *seed * 1664525 + 1013904223;
+        int d = (int)((*seed >> 8) % (2 * max_len + 1)) - max_len;
+        int limit = k % 2 ? HEIGHT : WIDTH;
+        if (abs(coords[k] - coords[k - 2]) > max_len) {
+            coords[k] = coords[k - 2] + d;
+        }
+        coords[k] = coords[k] < 0 ? 0 : coords[k] >= limit ? limit - 1 : coords[k];
+    }
+    if (coords[0] == coords[2] && coords[1] == coords[3]) {
+        coords[2] ^= 1;   // the float code divides by zero on a single point
+    }
+    *seed = *seed * 1664525 + 1013904223;
+    color_t color = *seed | 0xFF000000;
+
+    ref_clear(0xFF303030);
+    ref_draw_rect(100, 100, 600, 300, 0xFF80C040);
+    reference(coords[0], coords[1], coords[2], coords[3], color);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(0xFF303030);
+    gl_draw_rect(100, 100, 600, 300, 0xFF80C040);
+    gl_draw_line(coords[0], coords[1], coords[2], coords[3], color);
+    return max_channel_diff();
+}
+
+static void bench(const char *name, void (*before)(void), void (*after)(void)) {
+    double t = now_us();
+    for (int i = 0; i < REPS; i++) {
+        before();
+        touch();
+    }
+    double t_before = (now_us() - t) / REPS;
+    t = now_us();
+    for (int i = 0; i < REPS; i++) {
+        after();
+        touch();
+    }
+    double t_after = (now_us() - t) / REPS;
+    printf("  %-22s %8.1f us -> %7.1f us  (%.1fx)\n", name, t_before, t_after, t_before / t_after);
+}
+
+static void clear_before(void) { ref_clear(0xFF303030); }
+static void clear_after(void) { gl_clear(0xFF303030); }
+// the mixer's value box and a knob-sized rect, odd x for the unaligned path
+static void rects_before(void) {
+    ref_draw_rect(WIDTH / 2 - 150, HEIGHT / 2 + 100, 300, 50, GL_WHITE);
+    ref_draw_rect(211, 250, 121, 128, GL_WHITE);
+}
+static void rects_after(void) {
+    gl_draw_rect(WIDTH / 2 - 150, HEIGHT / 2 + 100, 300, 50, GL_WHITE);
+    gl_draw_rect(211, 250, 121, 128, GL_WHITE);
+}
+static void band_before(void) { ref_draw_rect(0, 100, WIDTH, 200, GL_BLACK); }
+static void band_after(void) { gl_draw_rect(0, 100, WIDTH, 200, GL_BLACK); }
+// the mixer's five knob indicators and the selection box
+static void knob_lines(void (*line)(int, int, int, int, color_t)) {
+    int spacing = WIDTH / 6;
+    for (int i = 1; i <= 5; i++) {
+        line(i * spacing, HEIGHT / 2, i * spacing, HEIGHT / 2 - 50, GL_WHITE);
+    }
+    line(153, 286, 273, 286, GL_WHITE);
+    line(153, 414, 273, 414, GL_WHITE);
+    line(153, 286, 153, 414, GL_WHITE);
+    line(273, 286, 273, 414, GL_WHITE);
+}
+static void knobs_before(void) { knob_lines(ref_draw_line); }
+static void knobs_after(void) { knob_lines(gl_draw_line); }
+static void diagonals(void (*line)(int, int, int, int, color_t)) {
+    for (int i = 0; i < 16; i++) {
+        line(i * 37, 0, WIDTH - 1 - i * 11, HEIGHT - 1, 0xFF00FFFF);
+        line(0, i * 29, WIDTH - 1, HEIGHT - 1 - i * 7, 0xFFFF8000);
+    }
+}
+static void diagonals_before(void) { diagonals(ref_draw_line); }
+static void diagonals_after(void) { diagonals(gl_draw_line); }
+
+// A full console screen, as draw_console used to draw it (char by char
+// over a clear) and as it does now (a run per row over a row fill)
+#define CONSOLE_ROWS (HEIGHT / (GLYPH_H + 5))
+#define CONSOLE_COLS (WIDTH / GLYPH_W)
+static char console_text[CONSOLE_ROWS][CONSOLE_COLS];
+static void console_before(void) {
+    ref_clear(GL_BLACK);
+    for (int row = 0; row < CONSOLE_ROWS; row++) {
+        for (int col = 0; col < CONSOLE_COLS; col++) {
+            ref_draw_char(col * GLYPH_W, row * (GLYPH_H + 5), console_text[row][col], GL_WHITE);
+        }
+    }
+}
+static void console_after(void) {
+    for (int row = 0; row < CONSOLE_ROWS; row++) {
+        gl_draw_rect(0, row * (GLYPH_H + 5), CONSOLE_COLS * GLYPH_W, GLYPH_H + 5, GL_BLACK);
+        gl_draw_chars(0, row * (GLYPH_H + 5), console_text[row], CONSOLE_COLS, GL_WHITE);
+    }
+}
+
+// The longest instructions() string, split and centered every frame
+// before, laid out once now
+static const char *instruction = "Use the left and right arrows to move along each control, and use the up and down arrows to change values, even while audio plays!";
+static void instructions_before(void) {
+    int per_line = WIDTH / GLYPH_W, n = strlen(instruction);
+    for (int start = 0, line = 0; start < n; start += per_line, line++) {
+        int len = n - start < per_line ? n - start : per_line;
+        int x = WIDTH / 2 - len * GLYPH_W / 2;
+        for (int i = start; i < start + len; i++, x += GLYPH_W) {
+            ref_draw_char(x, 10 + line * 20, instruction[i], GL_WHITE);
+        }
+    }
+}
+static gl_text_t instruction_layout;
+static void instructions_after(void) { gl_draw_text(&instruction_layout, GL_WHITE); }
+
+int main(void) {
+    gl_init(WIDTH, HEIGHT, GL_SINGLEBUFFER);
+
+    // same pixels as the original, clipping and odd alignments included
+    ref_clear(0xFF204060);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(0xFF204060);
+    assert(memcmp(snapshot, framebuffer, sizeof(framebuffer)) == 0);
+    check_rect(10, 10, 100, 50);
+    check_rect(11, 10, 1, 1);
+    check_rect(13, 7, 2, 3);
+    check_rect(-20, -5, 60, 40);
+    check_rect(WIDTH - 7, HEIGHT - 3, 50, 50);
+    check_rect(0, 30, WIDTH, 20);
+    check_rect(-1, 30, WIDTH + 2, 1);
+    check_rect(50, 50, 0, 10);
+    check_rect(50, 50, -5, 10);
+    check_rect(WIDTH, 0, 10, 10);
+
+    // horizontal, vertical and 45 degree lines, then random ones
+    ref_clear(0xFF000000);
+    knob_lines(ref_draw_line);
+    ref_draw_line(10, 10, 200, 200, GL_WHITE);
+    ref_draw_line(300, 10, 100, 210, GL_WHITE);
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(0xFF000000);
+    knob_lines(gl_draw_line);
+    gl_draw_line(10, 10, 200, 200, GL_WHITE);
+    gl_draw_line(300, 10, 100, 210, GL_WHITE);
+    assert(max_channel_diff() <= 1);
+    uint32_t seed = 1;
+    for (int i = 0; i < 300; i++) {
+        assert(check_line(ref_draw_line, 100, &seed) <= 1);
+    }
+    for (int i = 0; i < 300; i++) {
+        assert(check_line(exact_draw_line, WIDTH, &seed) <= 1);
+    }
+
+    // text from the atlas, clipped at each edge
+    check_string(100, 100, "Hello! Backing Track: On ~{}");
+    check_string(-20, 5, "left edge");
+    check_string(WIDTH - 30, HEIGHT - 10, "right and bottom");
+    check_string(50, -7, "top edge");
+    check_string(-WIDTH, 40, "off screen entirely");
+    check_string(3, 50, "\x01\x7f\x80\xff tab\tnewline\n");
+    ref_clear(GL_BLACK);
+    instructions_before();
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(GL_BLACK);
+    gl_text_layout(&instruction_layout, instruction, 0, 10, WIDTH, 20);
+    instructions_after();
+    assert(instruction_layout.nlines == 2);
+    assert(memcmp(snapshot, framebuffer, sizeof(framebuffer)) == 0);
+    for (int row = 0; row < CONSOLE_ROWS; row++) {
+        for (int col = 0; col < CONSOLE_COLS; col++) {
+            console_text[row][col] = (row * 31 + col * 7) % 11 == 0 ? ' ' : ' ' + (row + col * 3) % 95;
+        }
+    }
+    console_before();
+    memcpy(snapshot, framebuffer, sizeof(framebuffer));
+    gl_clear(GL_WHITE);
+    console_after();
+    for (int y = 0; y < CONSOLE_ROWS * (GLYPH_H + 5); y++) {
+        // the console is narrower than the screen
+        assert(memcmp((uint32_t *)snapshot + y * WIDTH, (uint32_t *)framebuffer + y * WIDTH, CONSOLE_COLS * GLYPH_W * 4) == 0);
+    }
+
+    // damage tracking covers everything each primitive touches
+    check_damage(damage_lines);
+    check_damage(damage_clipped);
+    check_damage(damage_text);
+    check_damage(knobs_after);
+
+    printf("gl_bench: %dx%d, per call:\n", WIDTH, HEIGHT);
+    printf("  full clear: %d byte stores -> %d 64-bit stores\n", WIDTH * HEIGHT * 4, WIDTH * HEIGHT / 2);
+    bench("gl_clear", clear_before, clear_after);
+    bench("gl_draw_rect (2 boxes)", rects_before, rects_after);
+    bench("gl_draw_rect (band)", band_before, band_after);
+    bench("gl_draw_line (knobs)", knobs_before, knobs_after);
+    bench("gl_draw_line (diagonals)", diagonals_before, diagonals_after);
+    bench("console screen", console_before, console_after);
+    bench("instructions text", instructions_before, instructions_after);
+    return 0;
+}
@@ -0,0 +1 @@
+// Host stand-in for the CS107e ccu.h (not used by the mocked drivers)
@@ -0,0 +1,11 @@
+// Host stand-in for the CS107e fb.h: the host tests provide the functions
+// over an in-memory framebuffer
+#pragma once
+typedef enum { FB_SINGLEBUFFER = 0, FB_DOUBLEBUFFER = 1 } fb_mode_t;
+
+void fb_init(int width, int height, fb_mode_t mode);
+int fb_get_width(void);
+int fb_get_height(void);
+int fb_get_depth(void);
+void *fb_get_draw_buffer(void);
+void fb_swap_buffer(void);
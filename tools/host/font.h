@@ -0,0 +1,8 @@
+// Host stand-in for the CS107e font.h: the host tests provide the font
+#include <stdbool.h>
+#include <stddef.h>
+
+int font_get_glyph_height(void);
+int font_get_glyph_width(void);
+int font_get_glyph_size(void);
+bool font_get_glyph(char ch, unsigned char buf[], size_t buflen);
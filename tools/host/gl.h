@@ -0,0 +1,28 @@
+// Host stand-in for our gl.h (the one in the library build), for host
+// tests that compile gl.c against an in-memory framebuffer
+#pragma once
+#include <stdbool.h>
+#include "fb.h"
+
+typedef enum { GL_SINGLEBUFFER = FB_SINGLEBUFFER, GL_DOUBLEBUFFER = FB_DOUBLEBUFFER } gl_mode_t;
+typedef unsigned int color_t;
+
+#define GL_BLACK 0xFF000000
+#define GL_WHITE 0xFFFFFFFF
+
+void gl_init(int width, int height, gl_mode_t mode);
+int gl_get_width(void);
+int gl_get_height(void);
+color_t gl_color(unsigned char r, unsigned char g, unsigned char b);
+void gl_swap_buffer(void);
+void gl_clear(color_t c);
+void gl_draw_pixel(int x, int y, color_t c);
+color_t gl_read_pixel(int x, int y);
+void gl_draw_rect(int x, int y, int w, int h, color_t c);
+void gl_draw_char(int x, int y, char ch, color_t c);
+void gl_draw_string(int x, int y, const char *str, color_t c);
+int gl_get_char_height(void);
+int gl_get_char_width(void);
+void gl_draw_line(int x0, int y0, int x1, int y1, color_t c);
+void gl_draw_triangle(int x1, int y1, int x2, int y2, int x3, int y3, color_t c);
+void gl_draw_circle(int x0, int y0, int radius, color_t c);
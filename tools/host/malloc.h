@@ -0,0 +1,9 @@
+// Host stand-in for the CS107e malloc.h: allocations go through counters
+// the host tests define, so they can check that the heap stops growing
+#include <stddef.h>
+
+void *host_malloc(size_t nbytes);
+void host_free(void *ptr);
+
+#define malloc host_malloc
+#define free host_free
@@ -0,0 +1,2 @@
+// Host stand-in for the CS107e strings.h
+#include <string.h>
@@ -0,0 +1,69 @@
+/* File: i2s_clock_gen.c
+ * ---------------------
+ *  Host tool: solves the I2S2 clock tree for the standard audio rates and
+ *  writes the precomputed table (i2s_clock_table.h) to stdout.
+ *
+ *  usage: i2s_clock_gen > i2s_clock_table.h
+ *
+ *  Every entry is checked against the PLL_AUDIO0 formula evaluated
+ *  independently in floating point, and the achieved rates are reported
+ *  on stderr. Build and run with `make i2s_clock_table.h`.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define I2S_CLOCK_NO_TABLE
+#include "../i2s_clock.c"
+
+// worst error accepted for a standard rate
+#define MAX_ERROR_PPM 1000
+
+static const int rates[] = {8000, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 192000};
+// 16-bit slots (playback) and 32-bit slots (mic, duplex)
+static const int frame_bclks[] = {32, 64};
+
+// (24MHz * N / M1 / M0) / P / 4, then the module and BCLK dividers
+static double formula_rate(const i2s_clock_config_t *c) {
+    double pll = 24e6 * (c->pll_n + 1) / (c->input_div2 + 1) / (c->output_div2 + 1) / (c->pll_p + 1) / 4;
+    return pll / I2S_CLOCK_MODULE_DIV / clkd_ratios[c->bclkdiv - 1] / c->bclks_per_frame;
+}
+
+int main(void) {
+    int failures = 0;
+
+    printf("// Generated by tools/i2s_clock_gen -- do not edit\n");
+    printf("static const i2s_clock_config_t i2s_clock_table[] = {\n");
+    for (int f = 0; f < (int)(sizeof(frame_bclks) / sizeof(frame_bclks[0])); f++) {
+        for (int r = 0; r < (int)(sizeof(rates) / sizeof(rates[0])); r++) {
+            i2s_clock_config_t c;
+            if (!i2s_clock_solve(rates[r], frame_bclks[f], &c)) {
+                fprintf(stderr, "i2s_clock_gen: %d Hz / %d bclks: no solution\n", rates[r], frame_bclks[f]);
+                failures++;
+                continue;
+            }
+            double achieved = formula_rate(&c);
+            double ppm = (achieved - rates[r]) / rates[r] * 1e6;
+            if (fabs(ppm - c.error_ppm) > 1.0 || fabs(ppm) > MAX_ERROR_PPM ||
+                fabs(achieved * 1000 - (double)i2s_clock_rate_mhz(&c)) > 1.0) {
+                fprintf(stderr, "i2s_clock_gen: %d Hz / %d bclks: solver disagrees with formula\n",
+                        rates[r], frame_bclks[f]);
+                failures++;
+            }
+            fprintf(stderr, "%6d Hz  %2d bclks  N=%3d P=%2d M1=%d M0=%d  PLL %8u Hz  BCLK /%-3d  -> %.3f Hz (%+d ppm)\n",
+                    rates[r], frame_bclks[f], c.pll_n + 1, c.pll_p + 1, c.input_div2 + 1, c.output_div2 + 1,
+                    i2s_clock_pll_hz(&c), clkd_ratios[c.bclkdiv - 1], achieved, (int)c.error_ppm);
+            printf("    {.rate = %d, .bclks_per_frame = %d, .pll_n = %d, .pll_p = %d, .input_div2 = %d, "
+                   ".output_div2 = %d, .bclkdiv = %d, .mclkdiv = %d, .error_ppm = %d},\n",
+                   c.rate, c.bclks_per_frame, c.pll_n, c.pll_p, c.input_div2, c.output_div2,
+                   c.bclkdiv, c.mclkdiv, (int)c.error_ppm);
+        }
+    }
+    printf("};\n");
+
+    if (failures) {
+        fprintf(stderr, "i2s_clock_gen: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
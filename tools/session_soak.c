@@ -0,0 +1,104 @@
+/* File: session_soak.c
+ * --------------------
+ *  Host soak test of the recording session: runs thousands of takes of
+ *  varying length and settings through the full effect chain and checks
+ *  that no take allocates, from the heap or from the audio arena. Then
+ *  fills the stage pool to check that a constructor that cannot get a
+ *  stage returns NULL and takes nothing. Build and run with
+ *  `make session_soak`.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "session.h"
+#include "compressor.h"
+#include "reverb.h"
+#include "looper.h"
+#include "arena.h"
+
+#define TAKES 2000
+#define RATE 8000           // keeps the soak quick; buffer handling does not depend on it
+#define MAX_SECONDS 3
+
+static long live_allocs, total_allocs;
+
+void *host_malloc(size_t nbytes) {
+    live_allocs++;
+    total_allocs++;
+    return malloc(nbytes);
+}
+
+void host_free(void *ptr) {
+    if (ptr) {
+        live_allocs--;
+    }
+    free(ptr);
+}
+
+int main(void) {
+    static const uint8_t silence[8 * 10];
+    // the backing stage only attaches a track at the chain's rate, whatever the session's
+    static const adpcm_asset_t track = {
+        .sample_rate = EFFECT_SAMPLE_RATE, .num_samples = 90, .block_bytes = 8, .block_samples = 9, .data = silence,
+    };
+    level_params_t level = {.level = 1};
+    compressor_params_t comp = {.threshold_db = -12, .ratio = 4, .knee_db = 6, .attack_ms = 5, .release_ms = 80};
+    reverb_params_t verb = {.room_size = 50, .damping = 50, .wet = 33, .dry = 100};
+    backing_params_t backing = {.track = &track, .at_end = ADPCM_LOOP};
+
+    effect_chain_t *chain = effect_chain_new(128);
+    effect_t *comp_fx = effect_compressor_new(&comp);
+    effect_t *verb_fx = effect_reverb_new(&verb);
+    effect_t *level_fx = effect_level_new(&level);
+    effect_t *looper_fx = effect_looper_new(4, RATE * MAX_SECONDS);
+    effect_t *backing_fx = effect_backing_new(&backing);
+    assert(chain && comp_fx && verb_fx && level_fx && looper_fx && backing_fx);
+    effect_chain_append(chain, comp_fx);
+    effect_chain_append(chain, verb_fx);
+    effect_chain_append(chain, level_fx);
+    effect_chain_append(chain, looper_fx);
+    effect_chain_append(chain, backing_fx);
+    session_init(chain, RATE, MAX_SECONDS);
+
+    long baseline_live = live_allocs, baseline_total = total_allocs;
+    size_t baseline_used = audio_arena.used, baseline_high = audio_arena.high_water;
+    uint32_t seed = 1;
+    for (int t = 0; t < TAKES; t++) {
+        // a different length and knob setting every take, like a user would
+        int seconds = 1 + t % (MAX_SECONDS + 1);   // includes one past the maximum
+        level.level = (t % 3) - 1 ? 1 : -2;
+        comp_fx->bypass = t & 1;
+        verb_fx->bypass = t & 2;
+
+        audio_buffer_t *take = session_begin_take(seconds);
+        assert(take->frames <= (unsigned)(RATE * MAX_SECONDS));
+        uint32_t *words = take->data;
+        for (unsigned i = 0; i < take->frames; i++) {
+            seed = seed * 1664525 + 1013904223;
+            words[i] = seed & 0xffff0000;   // captured noise
+        }
+        session_process_take();
+        assert(live_allocs == baseline_live && total_allocs == baseline_total);
+        assert(audio_arena.used == baseline_used && audio_arena.high_water == baseline_high);
+    }
+    assert(session_take_count() == TAKES);
+
+    // take every free stage, then one more: it fails without using the arena
+    static effect_t *extra[4 * EFFECT_CHAIN_MAX_STAGES];
+    int nextra = 0;
+    while ((extra[nextra] = effect_level_new(&level)) != NULL) {
+        nextra++;
+        assert(nextra < (int)(sizeof(extra) / sizeof(extra[0])));
+    }
+    size_t used = audio_arena.used;
+    assert(!effect_level_new(&level) && !effect_compressor_new(&comp) && !effect_reverb_new(&verb));
+    assert(!effect_looper_new(4, RATE) && !effect_backing_new(&backing));
+    assert(audio_arena.used == used);
+    while (nextra > 0) {
+        effect_delete(extra[--nextra]);
+    }
+    assert(effect_level_new(&level));
+    printf("session_soak: %d takes, %ld allocations (all at init), none per take\n", TAKES, baseline_total);
+    return 0;
+}
@@ -0,0 +1,189 @@
+/* File: wav2adpcm.c
+ * -----------------
+ *  Host tool: converts a 16-bit PCM WAV file into an IMA-ADPCM backing
+ *  track asset (a C header defining an adpcm_asset_t, see adpcm.h).
+ *
+ *  usage: wav2adpcm [-b block_bytes] input.wav name > name.h
+ *
+ *  Stereo input is mixed down to mono. Build with the host compiler,
+ *  e.g. `make wav2adpcm`.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEADER_BYTES 4      // ADPCM_BLOCK_HEADER_BYTES
+#define MAX_BLOCK_BYTES 512 // keeps blocks within ADPCM_MAX_BLOCK_SAMPLES
+#define SAMPLE_RATE 44100   // EFFECT_SAMPLE_RATE, the only rate the backing stage plays
+
+static const int step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static void die(const char *msg) {
+    fprintf(stderr, "wav2adpcm: %s\n", msg);
+    exit(1);
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+// Read a 16-bit PCM WAV file and return its samples mixed down to mono
+static int16_t *read_wav(const char *path, int *num_samples, int *sample_rate) {
+    FILE *f = fopen(path, "rb");
+    if (!f) die("cannot open input");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(size);
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) die("cannot read input");
+    fclose(f);
+
+    if (size < 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) die("not a WAV file");
+
+    int channels = 0, bits = 0;
+    const uint8_t *pcm = NULL;
+    uint32_t pcm_bytes = 0;
+    for (long off = 12; off + 8 <= size; ) {
+        uint32_t len = le32(buf + off + 4);
+        const uint8_t *body = buf + off + 8;
+        if (off + 8 + (long)len > size) len = size - off - 8;
+        if (!memcmp(buf + off, "fmt ", 4) && len >= 16) {
+            if (le16(body) != 1) die("only uncompressed PCM input is supported");
+            channels = le16(body + 2);
+            *sample_rate = le32(body + 4);
+            bits = le16(body + 14);
+        } else if (!memcmp(buf + off, "data", 4)) {
+            pcm = body;
+            pcm_bytes = len;
+        }
+        off += 8 + len + (len & 1);
+    }
+    if (!pcm || channels < 1) die("missing fmt or data chunk");
+    if (bits != 16) die("input must be 16-bit");
+
+    int n = pcm_bytes / (2 * channels);
+    int16_t *samples = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+        int sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += (int16_t)le16(pcm + 2 * (i * channels + c));
+        }
+        samples[i] = (int16_t)(sum / channels);
+    }
+    free(buf);
+    *num_samples = n;
+    return samples;
+}
+
+// Encode one sample against the running predictor, mirroring the decoder
+static int encode_sample(int sample, int *predictor, int *index) {
+    int step = step_table[*index];
+    int delta = sample - *predictor;
+    int code = 0;
+    if (delta < 0) {
+        code = 8;
+        delta = -delta;
+    }
+    int diff = step >> 3;
+    if (delta >= step) { code |= 4; delta -= step; diff += step; }
+    if (delta >= step >> 1) { code |= 2; delta -= step >> 1; diff += step >> 1; }
+    if (delta >= step >> 2) { code |= 1; diff += step >> 2; }
+
+    *predictor += (code & 8) ? -diff : diff;
+    if (*predictor > 32767) *predictor = 32767;
+    if (*predictor < -32768) *predictor = -32768;
+    *index += index_table[code & 7];
+    if (*index < 0) *index = 0;
+    if (*index > 88) *index = 88;
+    return code;
+}
+
+int main(int argc, char *argv[]) {
+    int block_bytes = 256;
+    int arg = 1;
+    if (argc > 2 && !strcmp(argv[1], "-b")) {
+        block_bytes = atoi(argv[2]);
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: wav2adpcm [-b block_bytes] input.wav name > name.h\n");
+        return 1;
+    }
+    if (block_bytes <= HEADER_BYTES || block_bytes > MAX_BLOCK_BYTES) die("block size out of range");
+    const char *name = argv[arg + 1];
+
+    int num_samples, sample_rate = 0;
+    int16_t *samples = read_wav(argv[arg], &num_samples, &sample_rate);
+    if (num_samples == 0) die("input has no samples");
+    if (sample_rate != SAMPLE_RATE) {
+        // not fatal: the asset is still valid, the firmware just will not play it
+        fprintf(stderr, "wav2adpcm: warning: input is %d Hz, the backing stage only plays %d Hz\n",
+                sample_rate, SAMPLE_RATE);
+    }
+
+    int block_samples = (block_bytes - HEADER_BYTES) * 2 + 1;
+    int num_blocks = (num_samples + block_samples - 1) / block_samples;
+    uint8_t *out = calloc(num_blocks, block_bytes);
+
+    int index = 0;
+    for (int b = 0; b < num_blocks; b++) {
+        const int16_t *in = samples + b * block_samples;
+        int n = num_samples - b * block_samples;
+        if (n > block_samples) n = block_samples;
+        uint8_t *p = out + b * block_bytes;
+
+        // the header restarts the predictor on an exact sample
+        int predictor = in[0];
+        p[0] = predictor & 0xff;
+        p[1] = (predictor >> 8) & 0xff;
+        p[2] = index;
+        p[3] = 0;
+        p += HEADER_BYTES;
+        for (int i = 1; i < n; i++) {
+            int code = encode_sample(in[i], &predictor, &index);
+            if (i & 1) {
+                *p = code;
+            } else {
+                *p++ |= code << 4;
+            }
+        }
+    }
+
+    printf("// Generated by tools/wav2adpcm from %s -- do not edit\n", argv[arg]);
+    printf("#include \"adpcm.h\"\n\n");
+    printf("static const uint8_t %s_data[%d] = {", name, num_blocks * block_bytes);
+    for (int i = 0; i < num_blocks * block_bytes; i++) {
+        printf("%s0x%02x,", i % 16 ? " " : "\n    ", out[i]);
+    }
+    printf("\n};\n\n");
+    printf("static const adpcm_asset_t %s = {\n", name);
+    printf("    .sample_rate = %d,\n", sample_rate);
+    printf("    .num_samples = %d,\n", num_samples);
+    printf("    .block_bytes = %d,\n", block_bytes);
+    printf("    .block_samples = %d,\n", block_samples);
+    printf("    .data = %s_data,\n", name);
+    printf("};\n");
+
+    fprintf(stderr, "wav2adpcm: %d samples at %d Hz, %d blocks, %d -> %d bytes\n",
+            num_samples, sample_rate, num_blocks, num_samples * 2, num_blocks * block_bytes);
+    free(out);
+    free(samples);
+    return 0;
+}